@@ -55,6 +55,7 @@
 #include             "global.h"
 #include             "syscalls.h"
 #include             "protos.h"
+#include             "pcb.h"
 #include             "string.h"
 #include             <stdlib.h>
 #include             <ctype.h>
@@ -69,18 +70,6 @@
 int DiskID;//Used for storing QID
 INT32 LockResult;//Used for doing lock and unlock
 
-//PCB structure
-struct PCB {
-	long Context;//Context of the process
-	long pid;//Process ID of the process
-	char *name;//Name of the process
-	long order;//Priority of the process
-	int ptime;//Wake-up time of the process
-	int status;//Used for checking whether this process has been terminated or not
-			   //(when status=0, it means that this process have been terminated)
-	int diskid;//Used for storing disk id when doing some disk operations
-};
-
 
 // Used for initializing the disk queue.
 void InitialDisk()
@@ -98,7 +87,7 @@ void InsertDiskTail(void *insert)
 {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 3, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	QInsertOnTail(DiskID, insert);//Insert the item to the tail of disk queue
+	((struct PCB *)insert)->qnode = QInsertOnTailNode(DiskID, insert);//Insert the item to the tail of disk queue
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 3, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
 }
@@ -109,7 +98,7 @@ void InsertDiskHead(void *insert)
 {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 3, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	QInsert(DiskID,0,insert);//Insert the item to the disk queue with an order of 0
+	((struct PCB *)insert)->qnode = QInsertNode(DiskID, 0, insert);//Insert the item to the disk queue with an order of 0
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 3, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
 }
@@ -121,18 +110,24 @@ void InsertDiskOrder(void *insert, int order)
 {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 3, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	QInsert(DiskID, order, insert);//Insert the item to the disk queue with an order
+	((struct PCB *)insert)->qnode = QInsertNode(DiskID, order, insert);//Insert the item to the disk queue with an order
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 3, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
 }
 
 // Used for removing an item from the disk queue.
 //void *insert is the address of the item you want to remove.
+//The node kept in the PCB is unlinked, so the queue is not walked.
 void RemoveDiskItem(void *insert)
 {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 3, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	QRemoveItem(DiskID, insert);//Remove the item from the disk queue
+	struct PCB *item = (struct PCB *)insert;
+	if (item->qnode != NULL)
+	{
+		QRemoveNode(DiskID, item->qnode);//Remove the item from the disk queue
+		item->qnode = NULL;
+	}
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 3, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
 }
@@ -142,7 +137,11 @@ void RemoveDiskHead()
 {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 3, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	QRemoveHead(DiskID);//Remove the head item from the disk queue
+	struct PCB *item = (struct PCB *)QRemoveHead(DiskID);//Remove the head item from the disk queue
+	if ((long)item != -1)
+	{
+		item->qnode = NULL;
+	}
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 3, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
 }
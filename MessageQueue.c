@@ -0,0 +1,260 @@
+/************************************************************************
+
+ This code includes functions used for doing operations on message queue.
+
+ void InitialMessage();
+ Used for initializing the message queue.
+
+ void InsertMessageTail(void *insert);
+ Used for inserting an item to the tail of the message queue.
+ void *insert is the address of the item you want to insert.
+
+ void InsertMessageHead(void *insert);
+ Used for inserting an item to the head of the message queue.
+ void *insert is the address of the item you want to insert.
+
+ void InsertMessageOrder(void *insert, int order);
+ Used for inserting an item to the message queue with an specific order.
+ void *insert is the address of the item you want to insert.
+ int order is the order you want to give to this item.
+
+ void RemoveMessageItem(void *insert);
+ Used for removing an item from the message queue.
+ void *insert is the address of the item you want to remove.
+
+ void RemoveMessageHead();
+ Used for removing the item at the head of the message queue.
+
+ int MessageExists(void *insert);
+ Used for checking whether a specific item exists in the message queue or not.
+ void *insert is the address of the item you want to check.
+ If exist - return 1
+ If not exist - return 0
+
+ int MessageEmpty();
+ Used for checking whether message queue is empty or not.
+ If empty - return 1
+ If not empty - return 0
+
+ void MessageQPrint();
+ Used for printing the whole structure of message queue.
+ A function used for debugging.
+
+ int MessageReadPID(int order);
+ Used for reading the pid of PCB item at a specific location of message queue.
+ int order is the order of item you wnat to find.
+ (For example, first item has order 0, second item has order 1, and so on)
+ return the corresponding PID, if doesn't exist, return -1.
+
+ char *MessageReadName(int order);
+ Used for reading the name of PCB item at a specific location of message queue.
+ int order is the order of item you wnat to find.
+ (For example, first item has order 0, second item has order 1, and so on)
+ return the corresponding name, if doesn't exist, return -1.
+ ************************************************************************/
+#include             "global.h"
+#include             "syscalls.h"
+#include             "protos.h"
+#include             "pcb.h"
+#include             "string.h"
+#include             <stdlib.h>
+#include             <ctype.h>
+#include             <unistd.h>
+
+#define                  DO_LOCK                     1
+#define                  DO_UNLOCK                   0
+#define                  SUSPEND_UNTIL_LOCKED        TRUE
+#define                  DO_NOT_SUSPEND              FALSE
+#define                  MEMORY_INTERLOCK_BASE       0x7FE00000
+
+int MessageID; //Used for storing QID
+INT32 LockResult; //Used for doing lock and unlock
+
+
+// Used for initializing the message queue.
+void InitialMessage()
+{
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Lock
+	MessageID = QCreate("MessageQ");//Create a queue called "MessageQ"
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Unlock
+}
+
+// Used for inserting an item to the tail of the message queue.
+//void *insert is the address of the item you want to insert.
+void InsertMessageTail(void *insert)
+{
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	((struct PCB *)insert)->qnode = QInsertOnTailNode(MessageID, insert);//Insert the item to the tail of message queue
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+}
+
+//Used for inserting an item to the head of the message queue.
+//void *insert is the address of the item you want to insert.
+void InsertMessageHead(void *insert)
+{
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	((struct PCB *)insert)->qnode = QInsertNode(MessageID, 0, insert);//Insert the item to the message queue with an order of 0
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+}
+
+//Used for inserting an item to the message queue with an specific order.
+//void *insert is the address of the item you want to insert.
+//int order is the order you want to give to this item.
+void InsertMessageOrder(void *insert, int order)
+{
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	((struct PCB *)insert)->qnode = QInsertNode(MessageID, order, insert);//Insert the item to the message queue with an order
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+}
+
+// Used for removing an item from the message queue.
+//void *insert is the address of the item you want to remove.
+//The node kept in the PCB is unlinked, so the queue is not walked.
+void RemoveMessageItem(void *insert)
+{
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	struct PCB *item = (struct PCB *)insert;
+	if (item->qnode != NULL)
+	{
+		QRemoveNode(MessageID, item->qnode);//Remove the item from the message queue
+		item->qnode = NULL;
+	}
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+}
+
+// Used for removing the item at the head of the message queue.
+void RemoveMessageHead()
+{
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	struct PCB *item = (struct PCB *)QRemoveHead(MessageID);//Remove the head item from the message queue
+	if ((long)item != -1)
+	{
+		item->qnode = NULL;
+	}
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+}
+
+//Used for checking whether a specific item exists in the message queue or not.
+//void *insert is the address of the item you want to check.
+//If exist - return 1
+//If not exist - return 0
+int MessageExists(void *insert) 
+{
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	int *exist = (int *)QItemExists(MessageID, insert);//Check whether this item exists in message queue or not
+	if ((long)exist == -1)
+	{
+		//Not exist
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		return 0;
+	}
+	else
+	{
+		//Exist
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		return 1;
+	}
+}
+
+// Used for checking whether message queue is empty or not.
+//If empty - return 1
+//If not empty - return 0
+int MessageEmpty() {
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	int *isempty=(int *)QNextItemInfo(MessageID);//Check whether the message queue is empty or not
+	if ((long)isempty == -1)
+	{
+		//Empty
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		return 1;
+	}
+	else
+	{
+		//Not empty
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		return 0;
+	}
+}
+
+//Used for printing the whole structure of message queue.
+//A function used for debugging.
+void MessageQPrint() {
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	QPrint(MessageID);//Do the print
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+}
+
+
+//Used for reading the pid of PCB item at a specific location of message queue.
+//int order is the order of item you wnat to find.
+//(For example, first item has order 0, second item has order 1, and so on)
+//return the corresponding PID, if doesn't exist, return -1.
+int MessageReadPID(int order) {
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	struct PCB *op;//Used for storing the return value
+	int *check = (int *)QWalk(MessageID, order);//Check whether the order is valid or not
+	if ((long)check == -1)
+	{
+		//Not exist
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		return -1;
+	}
+	else
+	{
+		//Exist
+		op = QWalk(MessageID, order);//Get the specific item from message queue
+	}
+	int pid = op->pid;//Get the pid of returning PCB
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	return pid;//Return the pid
+}
+
+// Used for reading the name of PCB item at a specific location of message queue.
+//int order is the order of item you wnat to find.
+//(For example, first item has order 0, second item has order 1, and so on)
+//return the corresponding name, if doesn't exist, return -1.
+char *MessageReadName(int order) {
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	struct PCB *op;//Used for store the return value
+	int *check = (int *)QWalk(MessageID, order);//Check whether the order is valid or not
+	if ((long)check == -1)
+	{
+		//Not exist
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		return (char *)-1;
+	}
+	else
+	{
+		//Exist
+		op = QWalk(MessageID, order);//Get the specific item from message queue
+	}
+	char *name = op->name;//Get the name of PCB
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 8, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	return name;//Return the name
+}
\ No newline at end of file
@@ -43,6 +43,12 @@
         Output: The routine always returns 0.  But if there's an error
               the simulation ends.
 
+  void *QInsertNode(int QID, unsigned int QueueOrder, void *EnqueueingStructure);
+  void *QInsertOnTailNode(int QID, void *EnqueueingStructure);
+       The same as QInsert() and QInsertOnTail(), but the node that now
+       holds the item on the Q is returned.  Keep it and give it to
+       QRemoveNode() to take the item off without a walk of the Q.
+
   void *QRemoveHead(int QID);
        Dequeue an item from the head of the designated Q.  The address
        of the item is returned to the caller and the item is removed
@@ -61,6 +67,14 @@
                matches the EnqueueingStructure address and has been dequeued.
                If no matching item is found on the Q, the return value = -1.
 
+  void *QRemoveNode(int QID, void *Node);
+       Dequeue the item held by a node returned from QInsertNode() or
+       QInsertOnTailNode().  Each node is linked back to the one before
+       it, so this takes the same time wherever the item is on the Q.
+       Input: QID - The ID that describes the target Q.
+       Input: Node - The node the item was inserted with.
+       Output: The address of the structure that has been dequeued.
+
   void *QNextItemInfo(int QID);
        Get information about the item on the head of the designated Q.
        The item is NOT removed from the Queue.
@@ -118,6 +132,8 @@ Struct = 001D2180, Order = 4294967295, QdStruct = 40EA6C, ... QNext = FFFFFFFF
 ***************************************************************************/
 /***************************************************************************
       Rel 4.50  Apr 2018  Initial release of the QueueManager
+                          Items are linked back to the item before them
+                          so a known node is removed without a walk
 ***************************************************************************/
 #include    <stdio.h>
 #include    <stdlib.h>
@@ -146,6 +162,8 @@ typedef struct {
     unsigned int QueueOrder;    // For an ordered Q, the position in the Q
     void *QdStructure;          // What the caller gave us to hang to.
     int ItemStructID;
+    void *prev;                 // Pointer to previous QItem, or the Q_HEAD
+                                // for the head item.  Only its queue field is used.
 } Q_ITEM;
 
 // Global Variables
@@ -204,6 +222,15 @@ int  QCreate(char *QNameDescriptor)  {
               the simulation ends.
 ***************************************************************************/
 int  QInsert(int QID, unsigned int QueueOrder, void *EnqueueingStructure) {
+    QInsertNode( QID, QueueOrder, EnqueueingStructure );
+    return 0;
+} // End of QInsert
+
+/**************************************************************************
+  void *QInsertNode(int QID, unsigned int QueueOrder, void *EnqueueingStructure);
+      The same as QInsert(), but returns the node that holds the item.
+***************************************************************************/
+void *QInsertNode(int QID, unsigned int QueueOrder, void *EnqueueingStructure) {
     Q_ITEM *QItem;
     Q_ITEM *temp_ptr, *last_ptr;
 
@@ -213,8 +240,7 @@ int  QInsert(int QID, unsigned int QueueOrder, void *EnqueueingStructure) {
 
     // Go to the special code that will place this item on the tail of the Q.
     if (QueueOrder == UINT_MAX)  {
-    	QInsertOnTail( QID, EnqueueingStructure );
-    	return 0;
+    	return QInsertOnTailNode( QID, EnqueueingStructure );
     }
     QItem = (Q_ITEM *) malloc(sizeof(Q_ITEM));
     if (QItem == 0)
@@ -224,6 +250,7 @@ int  QInsert(int QID, unsigned int QueueOrder, void *EnqueueingStructure) {
     QItem->QueueOrder  = QueueOrder;
     QItem->QdStructure = EnqueueingStructure;
     QItem->ItemStructID= Q_STRUCTURE_ID;
+    QItem->prev        = (void *)(&Queues[QID]);
 
     // Is there nothing on the Q?
     if ( Queues[QID].queue == (Q_ITEM *)-1) {
@@ -236,11 +263,14 @@ int  QInsert(int QID, unsigned int QueueOrder, void *EnqueueingStructure) {
     		// Is our new item "before" the item we're looking at
     		if (QueueOrder < temp_ptr->QueueOrder  ) { // Yes - enqueue
     			QItem->queue = last_ptr->queue;
+    			QItem->prev = (void *) last_ptr;
     			last_ptr->queue = (void *) QItem;
+    			temp_ptr->prev = (void *) QItem;
     			break;
     		}
     		if (temp_ptr->queue == (void *)-1) {   // End of Q or empty
     			temp_ptr->queue = (INT32 *) QItem;
+    			QItem->prev = (void *) temp_ptr;
     			break;
     		}
     		last_ptr = temp_ptr;
@@ -249,8 +279,8 @@ int  QInsert(int QID, unsigned int QueueOrder, void *EnqueueingStructure) {
     }  // End of else
 
     QProclaim("Exiting QInsert:  QID = %d, QOrder = %d\n", QID, QueueOrder);
-    return 0;
-} // End of QInsert
+    return (void *) QItem;
+} // End of QInsertNode
 
 /**************************************************************************
 int  QInsertOnTail(int QID, void *EnqueueingStructure);
@@ -262,6 +292,15 @@ int  QInsertOnTail(int QID, void *EnqueueingStructure);
              the simulation ends.
 ***************************************************************************/
 int  QInsertOnTail(int QID, void *EnqueueingStructure) {
+    QInsertOnTailNode( QID, EnqueueingStructure );
+    return 0;
+}       // End of QInsertOnTail
+
+/**************************************************************************
+void *QInsertOnTailNode(int QID, void *EnqueueingStructure);
+     The same as QInsertOnTail(), but returns the node that holds the item.
+***************************************************************************/
+void *QInsertOnTailNode(int QID, void *EnqueueingStructure) {
     Q_ITEM *QItem;
     Q_ITEM *temp_ptr;
     Q_ITEM *last_ptr;
@@ -279,6 +318,7 @@ int  QInsertOnTail(int QID, void *EnqueueingStructure) {
     QItem->QueueOrder   = UINT_MAX;
     QItem->QdStructure  = EnqueueingStructure;
     QItem->ItemStructID = Q_STRUCTURE_ID;
+    QItem->prev         = (void *)(&Queues[QID]);
 
     // Is there nothing on the Q?
     if ( Queues[QID].queue == (Q_ITEM *)-1) {
@@ -295,9 +335,10 @@ int  QInsertOnTail(int QID, void *EnqueueingStructure) {
     		temp_ptr = (Q_ITEM *) temp_ptr->queue;
     	}
     	last_ptr->queue = QItem;
+    	QItem->prev = (void *) last_ptr;
     }   // End of else
-    return 0;
-}       // End of QInsertOnTail
+    return (void *) QItem;
+}       // End of QInsertOnTailNode
 
 /**************************************************************************
   void *QRemoveHead(int QID);
@@ -321,6 +362,9 @@ void *QRemoveHead(int QID) {
     QItem = (Q_ITEM *) Queues[QID].queue;   // This is the head item
 
     Queues[QID].queue = QItem->queue;       // Remove the head item
+    if (QItem->queue != (void *)-1) {
+        ((Q_ITEM *) QItem->queue)->prev = (void *)(&Queues[QID]);
+    }
     QItem->queue = 0;                       // Disable the item we removed
 
     if (QItem->ItemStructID != Q_STRUCTURE_ID) {
@@ -362,6 +406,9 @@ void *QRemoveItem(int QID, void *EnqueueingStructure) {
 		// Is this the item we're looking at
 		if (EnqueueingStructure == temp_ptr->QdStructure  ) { // Yes - dequeue
 			last_ptr->queue = temp_ptr->queue;
+			if (temp_ptr->queue != (void *)-1) {
+				((Q_ITEM *) temp_ptr->queue)->prev = (void *) last_ptr;
+			}
 			ReturnPointer = (void *) temp_ptr->QdStructure;
 			break;
 		}
@@ -384,6 +431,36 @@ void *QRemoveItem(int QID, void *EnqueueingStructure) {
     return (ReturnPointer );
 }    // End of QRemoveItem
 
+/**************************************************************************
+void *QRemoveNode(int QID, void *Node);
+     Dequeue the item held by a node from QInsertNode() or QInsertOnTailNode().
+     Input: QID - The ID that describes the target Q.
+     Input: Node - The node the item was inserted with.
+     Output: The address of the structure that has been dequeued.
+***************************************************************************/
+void *QRemoveNode(int QID, void *Node) {
+    void *ReturnPointer;
+    Q_ITEM *QItem = (Q_ITEM *) Node;
+
+    QProclaim("Entering QRemoveNode:  QID = %d\n", QID);
+    // Check the inputs are legal - if not legal, we QPanic
+    QCheckValidity( QID, 42 );
+
+    if (QItem->ItemStructID != Q_STRUCTURE_ID) {
+        QPanic("Bad structure ID in QRemoveNode");
+    }
+    ((Q_ITEM *) QItem->prev)->queue = QItem->queue;     // Unlink from the one before
+    if (QItem->queue != (void *)-1) {
+        ((Q_ITEM *) QItem->queue)->prev = QItem->prev;  // and from the one after
+    }
+
+    QItem->ItemStructID = 0; // make sure this isn't mistaken
+    ReturnPointer = QItem->QdStructure;
+    free(QItem);
+    QProclaim("Exiting QRemoveNode", QID);
+    return (ReturnPointer );
+}    // End of QRemoveNode
+
 /**************************************************************************
 void *QNextItemInfo(int QID);
      Get information about the item on the head of the designated Q.
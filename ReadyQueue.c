@@ -2,6 +2,13 @@
 
  This code includes functions used for doing operations on ready queue.
 
+ The ready queue is kept as a red-black tree ordered by the key given at
+ insert time (the virtual runtime of the process), so the dispatcher can
+ always pick the process with the least virtual runtime and inserting or
+ removing a process costs O(log n) instead of a walk of a linked list.
+ Items with the same key keep the order they were inserted in.
+ The leftmost node is cached so reading the head is O(1).
+
  void InitialReady();
  Used for initializing the ready queue.
 
@@ -16,7 +23,7 @@
  void InsertReadyOrder(void *insert, int order);
  Used for inserting an item to the ready queue with an specific order.
  void *insert is the address of the item you want to insert.
- int order is the order you want to give to this item.
+ int order is the order you want to give to this item (the virtual runtime).
 
  void RemoveReadyItem(void *insert);
  Used for removing an item from the ready queue.
@@ -55,6 +62,7 @@
 #include             "global.h"
 #include             "syscalls.h"
 #include             "protos.h"
+#include             "pcb.h"
 #include             "string.h"
 #include             <stdlib.h>
 #include             <ctype.h>
@@ -66,28 +74,360 @@
 #define                  DO_NOT_SUSPEND              FALSE
 #define                  MEMORY_INTERLOCK_BASE       0x7FE00000
 
-int ReadyID; //Used for storing QID
+#define                  READY_MAX_NODES             64 //One node for each possible PID
+#define                  RED                         0
+#define                  BLACK                       1
+
 INT32 LockResult; //Used for doing lock and unlock
 
-//PCB structure
-struct PCB {
-	long Context;//Context of the process
-	long pid;//Process ID of the process
-	char *name;//Name of the process
-	long order;//Priority of the process
-	int ptime;//Wake-up time of the process
-	int status;//Used for checking whether this process has been terminated or not
-			   //(when status=0, it means that this process have been terminated)
-	int diskid;//Used for storing disk id when doing some disk operations
+//Node of the red-black tree
+struct RBNode {
+	void *item;//The PCB stored in this node
+	int key;//The order given when inserting
+	long seq;//Insert sequence, keeps items with the same key in FIFO order
+	int color;//RED or BLACK
+	int used;//1 when this node is on the tree
+	struct RBNode *left;
+	struct RBNode *right;
+	struct RBNode *parent;
 };
 
+struct RBNode ReadyNodes[READY_MAX_NODES];//Nodes of the tree, indexed by PID
+struct RBNode ReadyNil;//Sentinel used for all leaves
+struct RBNode *ReadyRoot;//Root of the tree
+struct RBNode *ReadyLeft;//Leftmost node (the head of the ready queue)
+long ReadySeq = 0;//Used for generating insert sequences
+long ReadyHeadSeq = 0;//Used for generating insert sequences of InsertReadyHead
+int ReadyCount = 0;//Number of items on the tree
+
+//Compare two nodes, return a negative value when a goes before b.
+static int RBCompare(struct RBNode *a, struct RBNode *b)
+{
+	if (a->key != b->key)
+		return (a->key < b->key) ? -1 : 1;
+	if (a->seq != b->seq)
+		return (a->seq < b->seq) ? -1 : 1;
+	return 0;
+}
+
+//Find the node used by an item, return NULL if the PID can't have a node.
+static struct RBNode *RBNodeOf(void *insert)
+{
+	long pid = ((struct PCB *)insert)->pid;
+	if (pid < 0 || pid >= READY_MAX_NODES)
+	{
+		aprintf("ReadyQueue: PID %ld out of range\n", pid);
+		return NULL;
+	}
+	return &ReadyNodes[pid];
+}
+
+//Return the leftmost node of a subtree
+static struct RBNode *RBMinimum(struct RBNode *x)
+{
+	while (x->left != &ReadyNil)
+		x = x->left;
+	return x;
+}
+
+//Return the node after x in an in-order walk
+static struct RBNode *RBNext(struct RBNode *x)
+{
+	if (x->right != &ReadyNil)
+		return RBMinimum(x->right);
+	struct RBNode *y = x->parent;
+	while (y != &ReadyNil && x == y->right)
+	{
+		x = y;
+		y = y->parent;
+	}
+	return y;
+}
+
+static void RBRotateLeft(struct RBNode *x)
+{
+	struct RBNode *y = x->right;
+	x->right = y->left;
+	if (y->left != &ReadyNil)
+		y->left->parent = x;
+	y->parent = x->parent;
+	if (x->parent == &ReadyNil)
+		ReadyRoot = y;
+	else if (x == x->parent->left)
+		x->parent->left = y;
+	else
+		x->parent->right = y;
+	y->left = x;
+	x->parent = y;
+}
+
+static void RBRotateRight(struct RBNode *x)
+{
+	struct RBNode *y = x->left;
+	x->left = y->right;
+	if (y->right != &ReadyNil)
+		y->right->parent = x;
+	y->parent = x->parent;
+	if (x->parent == &ReadyNil)
+		ReadyRoot = y;
+	else if (x == x->parent->right)
+		x->parent->right = y;
+	else
+		x->parent->left = y;
+	y->right = x;
+	x->parent = y;
+}
+
+//Replace the subtree at u with the subtree at v
+static void RBTransplant(struct RBNode *u, struct RBNode *v)
+{
+	if (u->parent == &ReadyNil)
+		ReadyRoot = v;
+	else if (u == u->parent->left)
+		u->parent->left = v;
+	else
+		u->parent->right = v;
+	v->parent = u->parent;
+}
+
+//Remove a node from the tree (the caller holds the lock)
+static void RBDelete(struct RBNode *z)
+{
+	struct RBNode *x;
+	struct RBNode *y = z;
+	int ycolor = y->color;
+
+	if (z == ReadyLeft)
+		ReadyLeft = RBNext(z);//Keep the cached head up to date
+
+	if (z->left == &ReadyNil)
+	{
+		x = z->right;
+		RBTransplant(z, z->right);
+	}
+	else if (z->right == &ReadyNil)
+	{
+		x = z->left;
+		RBTransplant(z, z->left);
+	}
+	else
+	{
+		y = RBMinimum(z->right);
+		ycolor = y->color;
+		x = y->right;
+		if (y->parent == z)
+			x->parent = y;
+		else
+		{
+			RBTransplant(y, y->right);
+			y->right = z->right;
+			y->right->parent = y;
+		}
+		RBTransplant(z, y);
+		y->left = z->left;
+		y->left->parent = y;
+		y->color = z->color;
+	}
+
+	//Fix the colors
+	if (ycolor == BLACK)
+	{
+		while (x != ReadyRoot && x->color == BLACK)
+		{
+			struct RBNode *w;
+			if (x == x->parent->left)
+			{
+				w = x->parent->right;
+				if (w->color == RED)
+				{
+					w->color = BLACK;
+					x->parent->color = RED;
+					RBRotateLeft(x->parent);
+					w = x->parent->right;
+				}
+				if (w->left->color == BLACK && w->right->color == BLACK)
+				{
+					w->color = RED;
+					x = x->parent;
+				}
+				else
+				{
+					if (w->right->color == BLACK)
+					{
+						w->left->color = BLACK;
+						w->color = RED;
+						RBRotateRight(w);
+						w = x->parent->right;
+					}
+					w->color = x->parent->color;
+					x->parent->color = BLACK;
+					w->right->color = BLACK;
+					RBRotateLeft(x->parent);
+					x = ReadyRoot;
+				}
+			}
+			else
+			{
+				w = x->parent->left;
+				if (w->color == RED)
+				{
+					w->color = BLACK;
+					x->parent->color = RED;
+					RBRotateRight(x->parent);
+					w = x->parent->left;
+				}
+				if (w->right->color == BLACK && w->left->color == BLACK)
+				{
+					w->color = RED;
+					x = x->parent;
+				}
+				else
+				{
+					if (w->left->color == BLACK)
+					{
+						w->right->color = BLACK;
+						w->color = RED;
+						RBRotateLeft(w);
+						w = x->parent->left;
+					}
+					w->color = x->parent->color;
+					x->parent->color = BLACK;
+					w->left->color = BLACK;
+					RBRotateRight(x->parent);
+					x = ReadyRoot;
+				}
+			}
+		}
+		x->color = BLACK;
+	}
+
+	z->used = 0;
+	z->item = NULL;
+	ReadyCount--;
+}
+
+//Put an item on the tree with a specific key and sequence (the caller holds the lock)
+static void RBInsert(void *insert, int key, long seq)
+{
+	struct RBNode *z = RBNodeOf(insert);
+	if (z == NULL)
+		return;
+	if (z->used)
+		RBDelete(z);//An item is never on the queue twice
+
+	z->item = insert;
+	z->key = key;
+	z->seq = seq;
+	z->left = z->right = &ReadyNil;
+	z->color = RED;
+	z->used = 1;
+
+	//Normal binary search tree insert
+	struct RBNode *y = &ReadyNil;
+	struct RBNode *x = ReadyRoot;
+	int leftmost = 1;
+	while (x != &ReadyNil)
+	{
+		y = x;
+		if (RBCompare(z, x) < 0)
+			x = x->left;
+		else
+		{
+			x = x->right;
+			leftmost = 0;
+		}
+	}
+	z->parent = y;
+	if (y == &ReadyNil)
+		ReadyRoot = z;
+	else if (RBCompare(z, y) < 0)
+		y->left = z;
+	else
+		y->right = z;
+	if (leftmost)
+		ReadyLeft = z;
+	ReadyCount++;
+
+	//Fix the colors
+	while (z->parent->color == RED)
+	{
+		struct RBNode *u;
+		if (z->parent == z->parent->parent->left)
+		{
+			u = z->parent->parent->right;
+			if (u->color == RED)
+			{
+				z->parent->color = BLACK;
+				u->color = BLACK;
+				z->parent->parent->color = RED;
+				z = z->parent->parent;
+			}
+			else
+			{
+				if (z == z->parent->right)
+				{
+					z = z->parent;
+					RBRotateLeft(z);
+				}
+				z->parent->color = BLACK;
+				z->parent->parent->color = RED;
+				RBRotateRight(z->parent->parent);
+			}
+		}
+		else
+		{
+			u = z->parent->parent->left;
+			if (u->color == RED)
+			{
+				z->parent->color = BLACK;
+				u->color = BLACK;
+				z->parent->parent->color = RED;
+				z = z->parent->parent;
+			}
+			else
+			{
+				if (z == z->parent->left)
+				{
+					z = z->parent;
+					RBRotateRight(z);
+				}
+				z->parent->color = BLACK;
+				z->parent->parent->color = RED;
+				RBRotateLeft(z->parent->parent);
+			}
+		}
+	}
+	ReadyRoot->color = BLACK;
+}
+
+//Return the node at a specific location of the in-order walk, NULL if it doesn't exist
+static struct RBNode *RBWalk(int order)
+{
+	if (order < 0 || order >= ReadyCount)
+		return NULL;
+	struct RBNode *x = ReadyLeft;
+	while (order > 0 && x != &ReadyNil)
+	{
+		x = RBNext(x);
+		order--;
+	}
+	return (x == &ReadyNil) ? NULL : x;
+}
+
 
 // Used for initializing the ready queue.
 void InitialReady()
 {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);//Lock
-	ReadyID = QCreate("ReadyQ");//Create a queue called "ReadyQ"
+	ReadyNil.color = BLACK;
+	ReadyNil.left = ReadyNil.right = ReadyNil.parent = &ReadyNil;
+	ReadyRoot = ReadyLeft = &ReadyNil;//Empty tree
+	for (int i = 0; i < READY_MAX_NODES; i++)
+	{
+		ReadyNodes[i].used = 0;
+	}
+	ReadyCount = 0;
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);//Unlock
 }
@@ -98,7 +438,16 @@ void InsertReadyTail(void *insert)
 {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	QInsertOnTail(ReadyID, insert);//Insert the item to the tail of ready queue
+	int key = 0;
+	if (ReadyRoot != &ReadyNil)
+	{
+		//Use the largest key, the new sequence puts it after all of them
+		struct RBNode *x = ReadyRoot;
+		while (x->right != &ReadyNil)
+			x = x->right;
+		key = x->key;
+	}
+	RBInsert(insert, key, ++ReadySeq);//Insert the item to the tail of ready queue
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
 }
@@ -109,7 +458,12 @@ void InsertReadyHead(void *insert)
 {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	QInsert(ReadyID,0,insert);//Insert the item to the ready queue with an order of 0
+	int key = 0;
+	if (ReadyLeft != &ReadyNil && ReadyLeft->key < 0)
+	{
+		key = ReadyLeft->key;
+	}
+	RBInsert(insert, key, --ReadyHeadSeq);//Insert the item before all the items with the smallest key
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
 }
@@ -121,7 +475,7 @@ void InsertReadyOrder(void *insert, int order)
 {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	QInsert(ReadyID, order, insert);//Insert the item to the ready queue with an order
+	RBInsert(insert, order, ++ReadySeq);//Insert the item to the ready queue with an order
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
 }
@@ -132,7 +486,11 @@ void RemoveReadyItem(void *insert)
 {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	QRemoveItem(ReadyID, insert);//Remove the item from the ready queue
+	struct RBNode *z = RBNodeOf(insert);
+	if (z != NULL && z->used && z->item == insert)
+	{
+		RBDelete(z);//Remove the item from the ready queue
+	}
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
 }
@@ -142,7 +500,10 @@ void RemoveReadyHead()
 {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	QRemoveHead(ReadyID);//Remove the head item from the ready queue
+	if (ReadyLeft != &ReadyNil)
+	{
+		RBDelete(ReadyLeft);//Remove the head item from the ready queue
+	}
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
 }
@@ -155,21 +516,11 @@ int ReadyExists(void *insert)
 {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	int *exist = (int *)QItemExists(ReadyID, insert);//Check whether this item exists in ready queue or not
-	if (exist == -1)
-	{
-		//Not exist
-		READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
-			&LockResult);
-		return 0;
-	}
-	else
-	{
-		//Exist
-		READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
-			&LockResult);
-		return 1;
-	}
+	struct RBNode *z = RBNodeOf(insert);
+	int exist = (z != NULL && z->used && z->item == insert);//Check whether this item exists in ready queue or not
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	return exist;
 }
 
 // Used for checking whether ready queue is empty or not.
@@ -178,21 +529,10 @@ int ReadyExists(void *insert)
 int ReadyEmpty() {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	int *isempty=(int *)QNextItemInfo(ReadyID);//Check whether the ready queue is empty or not
-	if (isempty == -1)
-	{
-		//Empty
-		READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
-			&LockResult);
-		return 1;
-	}
-	else
-	{
-		//Not empty
-		READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
-			&LockResult);
-		return 0;
-	}
+	int isempty = (ReadyRoot == &ReadyNil);//Check whether the ready queue is empty or not
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	return isempty;
 }
 
 //Used for printing the whole structure of ready queue.
@@ -200,7 +540,16 @@ int ReadyEmpty() {
 void ReadyQPrint() {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	QPrint(ReadyID);//Do the print
+	aprintf("ReadyQ: %d items\n", ReadyCount);
+	struct RBNode *x = ReadyLeft;
+	while (x != &ReadyNil)
+	{
+		//Do the print
+		aprintf("  PID: %ld  Name: %s  Key: %d  Color: %s\n",
+			((struct PCB *)x->item)->pid, ((struct PCB *)x->item)->name,
+			x->key, (x->color == RED) ? "Red" : "Black");
+		x = RBNext(x);
+	}
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
 }
@@ -213,21 +562,15 @@ void ReadyQPrint() {
 int ReadyReadPID(int order) {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	struct PCB *op;//Used for storing the return value
-	int *check = (int *)QWalk(ReadyID, order);//Check whether the order is valid or not
-	if (check==-1)
+	struct RBNode *x = RBWalk(order);//Get the specific item from ready queue
+	if (x == NULL)
 	{
 		//Not exist
 		READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 			&LockResult);
 		return -1;
 	}
-	else
-	{
-		//Exist
-		op = QWalk(ReadyID, order);//Get the specific item from ready queue
-	}
-	int pid = op->pid;//Get the pid of returning PCB
+	int pid = ((struct PCB *)x->item)->pid;//Get the pid of returning PCB
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
 	return pid;//Return the pid
@@ -240,22 +583,16 @@ int ReadyReadPID(int order) {
 char *ReadyReadName(int order) {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	struct PCB *op;//Used for store the return value
-	int *check = (int *)QWalk(ReadyID, order);//Check whether the order is valid or not
-	if (check == -1)
+	struct RBNode *x = RBWalk(order);//Get the specific item from ready queue
+	if (x == NULL)
 	{
 		//Not exist
 		READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 			&LockResult);
-		return -1;
-	}
-	else
-	{
-		//Exist
-		op = QWalk(ReadyID, order);//Get the specific item from ready queue
+		return (char *)-1;
 	}
-	char *name = op->name;//Get the name of PCB
+	char *name = ((struct PCB *)x->item)->name;//Get the name of PCB
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 1, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
 	return name;//Return the name
-}
\ No newline at end of file
+}
@@ -0,0 +1,260 @@
+/************************************************************************
+
+ This code includes functions used for doing operations on suspend queue.
+
+ void InitialSuspend();
+ Used for initializing the suspend queue.
+
+ void InsertSuspendTail(void *insert);
+ Used for inserting an item to the tail of the suspend queue.
+ void *insert is the address of the item you want to insert.
+
+ void InsertSuspendHead(void *insert);
+ Used for inserting an item to the head of the suspend queue.
+ void *insert is the address of the item you want to insert.
+
+ void InsertSuspendOrder(void *insert, int order);
+ Used for inserting an item to the suspend queue with an specific order.
+ void *insert is the address of the item you want to insert.
+ int order is the order you want to give to this item.
+
+ void RemoveSuspendItem(void *insert);
+ Used for removing an item from the suspend queue.
+ void *insert is the address of the item you want to remove.
+
+ void RemoveSuspendHead();
+ Used for removing the item at the head of the suspend queue.
+
+ int SuspendExists(void *insert);
+ Used for checking whether a specific item exists in the suspend queue or not.
+ void *insert is the address of the item you want to check.
+ If exist - return 1
+ If not exist - return 0
+
+ int SuspendEmpty();
+ Used for checking whether suspend queue is empty or not.
+ If empty - return 1
+ If not empty - return 0
+
+ void SuspendQPrint();
+ Used for printing the whole structure of suspend queue.
+ A function used for debugging.
+
+ int SuspendReadPID(int order);
+ Used for reading the pid of PCB item at a specific location of suspend queue.
+ int order is the order of item you wnat to find.
+ (For example, first item has order 0, second item has order 1, and so on)
+ return the corresponding PID, if doesn't exist, return -1.
+
+ char *SuspendReadName(int order);
+ Used for reading the name of PCB item at a specific location of suspend queue.
+ int order is the order of item you wnat to find.
+ (For example, first item has order 0, second item has order 1, and so on)
+ return the corresponding name, if doesn't exist, return -1.
+ ************************************************************************/
+#include             "global.h"
+#include             "syscalls.h"
+#include             "protos.h"
+#include             "pcb.h"
+#include             "string.h"
+#include             <stdlib.h>
+#include             <ctype.h>
+#include             <unistd.h>
+
+#define                  DO_LOCK                     1
+#define                  DO_UNLOCK                   0
+#define                  SUSPEND_UNTIL_LOCKED        TRUE
+#define                  DO_NOT_SUSPEND              FALSE
+#define                  MEMORY_INTERLOCK_BASE       0x7FE00000
+
+int SuspendID; //Used for storing QID
+INT32 LockResult; //Used for doing lock and unlock
+
+
+// Used for initializing the suspend queue.
+void InitialSuspend()
+{
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Lock
+	SuspendID = QCreate("SuspendQ");//Create a queue called "SuspendQ"
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Unlock
+}
+
+// Used for inserting an item to the tail of the suspend queue.
+//void *insert is the address of the item you want to insert.
+void InsertSuspendTail(void *insert)
+{
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	((struct PCB *)insert)->snode = QInsertOnTailNode(SuspendID, insert);//Insert the item to the tail of suspend queue
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+}
+
+//Used for inserting an item to the head of the suspend queue.
+//void *insert is the address of the item you want to insert.
+void InsertSuspendHead(void *insert)
+{
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	((struct PCB *)insert)->snode = QInsertNode(SuspendID, 0, insert);//Insert the item to the suspend queue with an order of 0
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+}
+
+//Used for inserting an item to the suspend queue with an specific order.
+//void *insert is the address of the item you want to insert.
+//int order is the order you want to give to this item.
+void InsertSuspendOrder(void *insert, int order)
+{
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	((struct PCB *)insert)->snode = QInsertNode(SuspendID, order, insert);//Insert the item to the suspend queue with an order
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+}
+
+// Used for removing an item from the suspend queue.
+//void *insert is the address of the item you want to remove.
+//The node kept in the PCB is unlinked, so the queue is not walked.
+void RemoveSuspendItem(void *insert)
+{
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	struct PCB *item = (struct PCB *)insert;
+	if (item->snode != NULL)
+	{
+		QRemoveNode(SuspendID, item->snode);//Remove the item from the suspend queue
+		item->snode = NULL;
+	}
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+}
+
+// Used for removing the item at the head of the suspend queue.
+void RemoveSuspendHead()
+{
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	struct PCB *item = (struct PCB *)QRemoveHead(SuspendID);//Remove the head item from the suspend queue
+	if ((long)item != -1)
+	{
+		item->snode = NULL;
+	}
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+}
+
+//Used for checking whether a specific item exists in the suspend queue or not.
+//void *insert is the address of the item you want to check.
+//If exist - return 1
+//If not exist - return 0
+int SuspendExists(void *insert) 
+{
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	int *exist = (int *)QItemExists(SuspendID, insert);//Check whether this item exists in suspend queue or not
+	if ((long)exist == -1)
+	{
+		//Not exist
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		return 0;
+	}
+	else
+	{
+		//Exist
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		return 1;
+	}
+}
+
+// Used for checking whether suspend queue is empty or not.
+//If empty - return 1
+//If not empty - return 0
+int SuspendEmpty() {
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	int *isempty=(int *)QNextItemInfo(SuspendID);//Check whether the suspend queue is empty or not
+	if ((long)isempty == -1)
+	{
+		//Empty
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		return 1;
+	}
+	else
+	{
+		//Not empty
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		return 0;
+	}
+}
+
+//Used for printing the whole structure of suspend queue.
+//A function used for debugging.
+void SuspendQPrint() {
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	QPrint(SuspendID);//Do the print
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+}
+
+
+//Used for reading the pid of PCB item at a specific location of suspend queue.
+//int order is the order of item you wnat to find.
+//(For example, first item has order 0, second item has order 1, and so on)
+//return the corresponding PID, if doesn't exist, return -1.
+int SuspendReadPID(int order) {
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	struct PCB *op;//Used for storing the return value
+	int *check = (int *)QWalk(SuspendID, order);//Check whether the order is valid or not
+	if ((long)check == -1)
+	{
+		//Not exist
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		return -1;
+	}
+	else
+	{
+		//Exist
+		op = QWalk(SuspendID, order);//Get the specific item from suspend queue
+	}
+	int pid = op->pid;//Get the pid of returning PCB
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	return pid;//Return the pid
+}
+
+// Used for reading the name of PCB item at a specific location of suspend queue.
+//int order is the order of item you wnat to find.
+//(For example, first item has order 0, second item has order 1, and so on)
+//return the corresponding name, if doesn't exist, return -1.
+char *SuspendReadName(int order) {
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	struct PCB *op;//Used for store the return value
+	int *check = (int *)QWalk(SuspendID, order);//Check whether the order is valid or not
+	if ((long)check == -1)
+	{
+		//Not exist
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		return (char *)-1;
+	}
+	else
+	{
+		//Exist
+		op = QWalk(SuspendID, order);//Get the specific item from suspend queue
+	}
+	char *name = op->name;//Get the name of PCB
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 7, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	return name;//Return the name
+}
\ No newline at end of file
@@ -49,6 +49,7 @@
 #include             "global.h"
 #include             "syscalls.h"
 #include             "protos.h"
+#include             "pcb.h"
 #include             "string.h"
 #include             <stdlib.h>
 #include             <ctype.h>
@@ -64,18 +65,6 @@
 int TimerID;//Used for storing QID
 INT32 LockResult;//Used for doing lock and unlock
 
-//PCB structure
-struct PCB {
-	long Context;//Context of the process
-	long pid;//Process ID of the process
-	char *name;//Name of the process
-	long order;//Priority of the process
-	int ptime;//Wake-up time of the process
-	int status;//Used for checking whether this process has been terminated or not
-			   //(when status=0, it means that this process have been terminated)
-	int diskid;//Used for storing disk id when doing some disk operations
-};
-
 
 // Used for initializing the timer queue.
 void InitialTimer()
@@ -93,7 +82,7 @@ void InsertTimerTail(void *insert)
 {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 2, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	QInsertOnTail(TimerID, insert);//Insert the item to the tail of timer queue
+	((struct PCB *)insert)->qnode = QInsertOnTailNode(TimerID, insert);//Insert the item to the tail of timer queue
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 2, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
 }
@@ -104,7 +93,7 @@ void InsertTimerHead(void *insert)
 {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 2, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	QInsert(TimerID,0,insert);//Insert the item to the timer queue with an order of 0
+	((struct PCB *)insert)->qnode = QInsertNode(TimerID, 0, insert);//Insert the item to the timer queue with an order of 0
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 2, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
 }
@@ -116,18 +105,24 @@ void InsertTimerOrder(void *insert,int order)
 {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 2, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	QInsert(TimerID, order, insert);//Insert the item to the timer queue with an order
+	((struct PCB *)insert)->qnode = QInsertNode(TimerID, order, insert);//Insert the item to the timer queue with an order
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 2, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
 }
 
 // Used for removing an item from the timer queue.
 //void *insert is the address of the item you want to remove.
+//The node kept in the PCB is unlinked, so the queue is not walked.
 void RemoveTimerItem(void *insert)
 {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 2, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	QRemoveItem(TimerID, insert);//Remove the item from the timer queue
+	struct PCB *item = (struct PCB *)insert;
+	if (item->qnode != NULL)
+	{
+		QRemoveNode(TimerID, item->qnode);//Remove the item from the timer queue
+		item->qnode = NULL;
+	}
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 2, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
 }
@@ -137,7 +132,11 @@ void RemoveTimerHead()
 {
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 2, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
-	QRemoveHead(TimerID);//Remove the head item from the timer queue
+	struct PCB *item = (struct PCB *)QRemoveHead(TimerID);//Remove the head item from the timer queue
+	if ((long)item != -1)
+	{
+		item->qnode = NULL;
+	}
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 2, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
 }
@@ -26,6 +26,7 @@
 #include             "global.h"
 #include             "syscalls.h"
 #include             "protos.h"
+#include             "pcb.h"
 #include             "string.h"
 #include             <stdlib.h>
 #include             <ctype.h>
@@ -38,13 +39,80 @@ INT32 LockResult;//Used for doing lock and unlock
 //  Allows the OS and the hardware to agree on where faults occur
 extern void *TO_VECTOR[];
 int checkp(char *name, int flag, int did, int ptr);
+int PriorityToWeight(long order);
+void ChargeRunningTime();
+void MakeReady(int pid);
+void HaltSystem();
+void Timestamp(int pid, int event);
+void LeaveQueue(int pid);
+void InitialSuspend();
+void InsertSuspendTail(void *insert);
+void RemoveSuspendItem(void *insert);
+int SuspendReadPID(int order);
+int getCurrentPID();
+void initMessages();
+void InitialMessage();
+void InsertMessageTail(void *insert);
+void RemoveMessageItem(void *insert);
+int MessageReadPID(int order);
+void FreeMailbox(int pid);
+void SendMessage(SYSTEM_CALL_DATA *SystemCallData);
+void ReceiveMessage(SYSTEM_CALL_DATA *SystemCallData);
+void DefineSharedArea(SYSTEM_CALL_DATA *SystemCallData);
+int findSharedArea(int pid, int page, int *index);
+void initFrames();
+void initMemoryTables();
+short **NewPageTable();
+short *PageEntry(int pid, int page);
+short PageValue(int pid, int page);
+void InvalidateTLB(int pid, int page);
+void releasePhysicalPage(int frame);
+void releaseSwap(int slot);
+void WakePageout();
+void ReadBack(int pid, int victim, int DiskStatus);
+void PrefetchAround(int pid, int page);
+void ResumeLoad();
+void ResumeSuspended(int pid);
+void IdleMemory();
+void AdjustQuota(int pid);
+void LoadControl(int pid);
+void dispatcher();
+void CallSchedulePrinter(int action, int target);
+long ReadClock();
+void RecordFault(int pid, int page, int major, long start, long faulttime);
+void MemoryPrinter(int frame);
+void UpdateMPFrame(int frame);
+void PrintMPChanges();
+int SwapOutCow(int owner, int page, int frame);
+void DropCowRef(int frame, int pid);
+void BreakCow(int pid, int page);
+int findFileMapping(int pid, int page, int *index);
+int MappedPageFresh(int pid, int map, int index);
+void ReadMappedPage(int pid, int map, int index, int frame);
+void WriteMappedPage(int pid, int map, int index, char *data);
+void FlushMappedPage(int pid, int map, int index, int keep);
+void MapFile(SYSTEM_CALL_DATA *SystemCallData);
+void UnmapFile(SYSTEM_CALL_DATA *SystemCallData);
+void DropFileMapping(int pid, int map);
+void UnmapFiles(int pid);
+void SyncMappedFiles(int did);
+int SharedFault(int pid, int page, int area, int index);
+void AddAreaMapper(int area);
+int SharedReferenced(int frame);
+int SwapOutShared(int frame);
+void WaitForFrame(int pid);
+void WaitForWrite(int pid);
+void SleepFor(int pid, int ticks);
+int ForkSwapFits(int parent);
+int TakeVictim(int pid, int MemoryStatus);
 
 char *call_names[] = {       "MemRead  ", "MemWrite ", "ReadMod  ", "GetTime  ",
 		"Sleep    ", "GetPid   ", "Create   ", "TermProc ", "Suspend  ",
 		"Resume   ", "ChPrior  ", "Send     ", "Receive  ", "PhyDskRd ",
 		"PhyDskWrt", "DefShArea", "Format   ", "CheckDisk", "OpenDir  ",
 		"OpenFile ", "CreaDir  ", "CreaFile ", "ReadFile ", "WriteFile",
-		"CloseFile", "DirContnt", "DelDirect", "DelFile  " };
+		"CloseFile", "DirContnt", "DelDirect", "DelFile  ", "MemRdBlk ",
+		"MemWrBlk ", "Fork     ", "MapFile  ", "UnmapFile" };
 
 long b;//Used for getting test address
 //Used for storing bitmap
@@ -55,40 +123,38 @@ struct bmd {
 
 struct bmd bitmaps[8][16];//Used for storing bitmap
 
-struct Swapinf {//Used for recording swap information
-	int used;
-	int regid;
-	int regadd;
-};
 
+int *MemoryOwner;//Used for recording the owner of each page
 
-//Structure of a single PCB
-struct PCB {
-		long Context;//Context of the process
-		long pid;//Process ID of the process
-		char *name;//Name of the process
-		long order;//Priority of the process
-		int ptime;//Wake-up time of the process
-		int status;//Used for checking whether this process has been terminated or not
-		           //(when status=0, it means that this process have been terminated)
-		int diskid;//Used for storing disk id when doing some disk operations
-		int cdid;//Current did
-		int csector;//Current sector
-		int Memory[64];//Related logical addresses
+int *MemoryOrder;//Used for recording the order of each page
 
-};
+int *MemoryAddress;//Used for recording the logical page of each page
+
+int *MemoryState;//Used for recording the state of each page
+
+int *MemoryShared;//Number of processes mapping each page of a shared area (0 for a private page)
+
+int *MemoryArea;//Page of a shared area held by each page, area * MAX_SHARED_PAGES + page (-1 for a private page)
+
+int *MemoryBusy;//Set while a page is being written out or read back, so it can't be chosen again
+
+int *MemorySwap;//Swap slot still holding a valid copy of each page (-1 when there is none)
 
-int MemoryOwner[64];//Used for recording the owner of each page
+int *MemoryPrefetched;//Set for a page read in ahead of a fault until it is used or chosen again
 
-int MemoryOrder[64];//Used for recording the order of each page
+int *MemoryCow;//Number of processes mapping each page copy-on-write (0 for a page of one process)
 
-int MemoryAddress[64];//Used for recording the logical page of each page
+#define                  FRAME_WORDS                 ((NUMBER_PHYSICAL_PAGES + 63) / 64)
 
-int MemoryState[64];//Used for recording the state of each page
+unsigned long long FreeFrames[(MAX_PHYSICAL_PAGES + 63) / 64];//Bitmap of the physical pages, a set bit means the page is free
 
-struct Swapinf Swap[400];
+int FreeFrameCount = 0;//Number of free physical pages
 
-MP_INPUT_DATA MPData;
+MP_INPUT_DATA MPData;//Kept up to date a physical page at a time, see UpdateMPFrame
+char MPChanged[MAX_PHYSICAL_PAGES];//Set for a physical page changed since the last print
+int MPChangedList[MAX_PHYSICAL_PAGES];//The physical pages changed since the last print
+int MPChangedCount = 0;
+int MPDeltaMode = 0;//When set, the memory printer prints only the changed physical pages
 
 
 
@@ -107,8 +173,6 @@ struct FDInformation {
 
 struct PCB Blocks[14];//List used for storing PCBs
 
-short *PAGE_TBL_ADDR;//Used for storing page table
-
 
 
 
@@ -123,6 +187,77 @@ struct FDInformation FDIs[50];//Used for storing File/Directory information
 #define                  LIMITED                     50
 #define                  INITIAL                     10
 #define                  NONE                        0
+#define                  NICE_0_WEIGHT               1024 //Weight of a process with priority 10
+#define                  PRIORITY_PER_STEP           2    //Priority difference for one weight step
+#define                  SLEEPER_CREDIT              50   //Virtual runtime credit kept by a waking process
+#define                  EVENT_CREATE                0
+#define                  EVENT_READY                 1
+#define                  EVENT_DISPATCH              2
+#define                  EVENT_SLEEP                 3
+#define                  EVENT_DISKWAIT              4
+#define                  EVENT_WAKE                  5
+#define                  EVENT_TERMINATE             6
+#define                  LATENCY_SAMPLES             1024 //Samples kept for each kind of latency of a process
+#define                  STATE_READY                 0
+#define                  STATE_RUNNING               1
+#define                  STATE_TIMER_WAIT            2
+#define                  STATE_DISK_WAIT             3
+#define                  STATE_SUSPENDED             4
+#define                  STATE_TERMINATED            5
+#define                  STATE_MSG_WAIT              6
+#define                  STATE_PAGEOUT_WAIT          7  //The pageout daemon is waiting for free pages to run low
+#define                  QUEUE_NONE                  0
+#define                  QUEUE_READY                 1
+#define                  QUEUE_TIMER                 2
+#define                  QUEUE_DISK                  3
+#define                  QUEUE_SUSPEND               4
+#define                  QUEUE_MESSAGE               5
+#define                  MAX_MESSAGE_LENGTH          64 //Longest message can be sent
+#define                  MAILBOX_SIZE                8  //Number of messages a mailbox can hold
+#define                  MESSAGE_POOL_SIZE           (15 * MAILBOX_SIZE) //14 mailboxes and the broadcast mailbox
+#define                  MAX_SHARED_AREAS            8  //Number of shared areas can be defined
+#define                  MAX_SHARED_PAGES            32 //Largest shared area in pages
+#define                  MAX_SHARED_TAG              32 //Longest tag of a shared area
+#define                  FILE_BLOCKS                 8  //Data blocks of a file, one for each entry of its index sector
+#define                  MAX_FILE_MAPPINGS           4  //Files a process can map at once
+#define                  SWAP_START_SECTOR           13  //First sector of the swap area on a swap disk
+#define                  SWAP_SECTORS                400 //Swap sectors on each swap disk
+#define                  SWAP_PAGE_SECTORS           (PGSIZE / DISK_SECTOR_SIZE) //Sectors holding one page
+#define                  SWAP_DISK_SLOTS             (SWAP_SECTORS / SWAP_PAGE_SECTORS) //Slots used on each swap disk
+#define                  SWAP_DISKS                  1   //Default number of disks used for swap, starting from disk 1
+#define                  SWAP_SLOTS                  (SWAP_SECTORS * MAX_NUMBER_OF_DISKS)
+#define                  SWAP_WORDS                  ((SWAP_SECTORS + 63) / 64) //Words of the free bitmap of one swap disk
+#define                  PAGEOUT_LOW                 4  //The pageout daemon is woken when fewer pages are free
+#define                  PAGEOUT_HIGH                8  //The pageout daemon goes back to wait when this many pages are free
+#define                  PAGEOUT_PRIORITY            1  //Priority of the pageout daemon
+#define                  FRAME_WAIT                  50 //Time a fault sleeps when no page can be evicted, see WaitForFrame
+#define                  WRITE_WAIT                  20 //Time a fault sleeps while its page is being written out, see WaitForWrite
+#define                  FAULT_BUCKETS               16 //Buckets of the fault latency histogram, bucket i holds times below 2^i
+#define                  PREFETCH_WINDOW             2  //Default number of pages read around a swapped page on each side
+#define                  PREFETCH_QUEUE              32 //Prefetch requests waiting for the pageout daemon
+#define                  PREFETCH_SAMPLE             32 //Prefetched pages judged before the hit rate is checked
+#define                  PREFETCH_MIN_HITS           8  //Fewer hits than this in a sample turns prefetch off for a while
+#define                  PREFETCH_BACKOFF            256 //Page faults to wait before trying prefetch again
+#define                  ZCACHE_ENTRIES              64 //Default number of pages the compressed swap cache holds
+#define                  ZCACHE_MAX                  256 //Largest compressed swap cache in pages
+#define                  ZCACHE_SLOT_BYTES           12 //A page is kept in the cache only if it compresses to this many bytes
+#define                  PFF_INITIAL                 8  //Quota of a process at its first page fault
+#define                  PFF_MIN                     4  //Smallest quota of a process
+#define                  PFF_LOW                     20 //Faulting again within this much CPU time grows the quota
+#define                  PFF_HIGH                    200 //Faulting again after this much CPU time shrinks the quota
+#define                  PFF_STEP                    2  //Pages added to the quota of a process faulting too often
+#define                  PFF_LIMIT                   (NUMBER_PHYSICAL_PAGES - PAGEOUT_LOW) //Quotas of the running processes must fit in this
+#define                  POLICY_FIFO                 0  //Evict the oldest page of the faulting process
+#define                  POLICY_CLOCK                1  //Global second-chance replacement
+#define                  FAULT_PHASES                4  //Parts of a page fault timed separately
+#define                  PHASE_SELECT                0  //Choosing a victim page
+#define                  PHASE_OUT                   1  //Writing the victim out to swap or the swap cache
+#define                  PHASE_IN                    2  //Reading the page back from swap or the swap cache
+#define                  PHASE_UPDATE                3  //Updating the page tables and the rest of the handler
+#define                  FREE_FRAMES_LOCK            11 //Lock of the free bitmap of the physical pages
+#define                  FRAME_LOCK_BASE             32 //First of the locks of the physical pages
+#define                  FRAME_LOCKS                 64 //Physical pages share the locks, page % FRAME_LOCKS
+#define                  MAPPED_PAGES                ((FILE_BLOCKS + SWAP_PAGE_SECTORS - 1) / SWAP_PAGE_SECTORS) //Logical pages a mapped file takes
 
 int svcprint=NONE;//Used for control the printing of svc
 int scheduleprint=NONE;//Used for control the printing of schedule printer
@@ -136,10 +271,188 @@ int endstart = 0;//Used for telling the schedule printer the start of terminatin
 int Inode = 0;
 int Sector = 0;
 int rootSet = 0;
-int memoryinit = 0;
 int clock = 0;
-int initswap = 0;
 int bitmapinit=0;
+long MinVruntime = 0;//Smallest virtual runtime of the dispatched processes
+int cfsprint = NONE;//Used for control the printing of the CPU share report
+int latencyprint = NONE;//Used for control the printing of the latency report
+int latencycsv = 0;//When set, the latency samples are also written to latency.csv
+
+//Latency samples of a single process, the newest LATENCY_SAMPLES are kept
+struct LatencyRecord {
+	int readywait[LATENCY_SAMPLES];//Time spent on the ready queue before each dispatch
+	int nready;
+	int iowait[LATENCY_SAMPLES];//Time spent on the disk queue
+	int nio;
+	int lateness[LATENCY_SAMPLES];//Wake-up time minus the asked wake-up time
+	int nlate;
+};
+
+struct LatencyRecord Latency[14];//Latency samples of each PCB
+
+//Structure of a single message
+struct Message {
+	int source;//PID of the sender
+	int target;//PID of the receiver (-1 means broadcast)
+	int length;//Length of the message
+	char buffer[MAX_MESSAGE_LENGTH];//Content of the message
+	struct Message *next;//Next message in the mailbox or in the free list
+};
+
+//Structure of a mailbox, a FIFO list of messages
+struct Mailbox {
+	struct Message *head;
+	struct Message *tail;
+	int count;
+};
+
+struct Message MessagePool[MESSAGE_POOL_SIZE];//All the message buffers, so sending doesn't malloc
+struct Message *FreeMessages = NULL;//List of the unused message buffers
+struct Mailbox Mailboxes[14];//Mailbox of each PCB
+struct Mailbox BroadcastBox;//Messages sent to -1, taken by the first process which wants them
+long MessagesSent = 0;//Number of messages sent
+long MessagesReceived = 0;//Number of messages received
+
+//Structure of a shared area, defined by the tag given to DEFINE_SHARED_AREA
+struct SharedArea {
+	int used;
+	char tag[MAX_SHARED_TAG];//Tag of the area
+	int pages;//Number of pages in the area
+	int frames[MAX_SHARED_PAGES];//Physical page of each page of the area (-1 when not in memory)
+	int slots[MAX_SHARED_PAGES];//Swap slot of each page of the area written out (-1 when there is none)
+	int changes[MAX_SHARED_PAGES];//Counts each time a page comes in or goes out, see SharedFault
+	int definers;//Number of processes which have defined this area
+	int mappers;//Number of processes mapping this area now
+};
+
+//Where a shared area is mapped in a process
+struct SharedMapping {
+	int area;//Index of the shared area (-1 when unused)
+	int start;//First logical page of the area in this process
+};
+
+struct SharedArea SharedAreas[MAX_SHARED_AREAS];
+struct SharedMapping SharedMappings[14][MAX_SHARED_AREAS];//Shared areas mapped by each PCB
+
+//Where a file is mapped in a process, see MapFile
+struct FileMapping {
+	int inode;//Inode of the file (-1 when unused)
+	int did;//Disk of the file
+	int start;//First logical page of the file in this process
+	int indexsector;//Index sector of the file
+	UINT16 index[FILE_BLOCKS];//Data sector of each block, read when the file is mapped
+	char fresh[FILE_BLOCKS];//Set for a block given its sector by the mapping and not written yet
+};
+
+struct FileMapping FileMappings[14][MAX_FILE_MAPPINGS];//Files mapped by each PCB
+
+int ReplacePolicy = POLICY_CLOCK;//Page replacement policy
+int ClockHand = 0;//Next physical page looked at by the CLOCK policy
+long PageFaults = 0;//Number of page faults
+long PageIns = 0;//Number of pages read back from swap
+long PageOuts = 0;//Number of pages written to swap
+long SwapWritesAvoided = 0;//Number of clean pages dropped without writing them to swap
+
+unsigned long long FreeSwap[MAX_NUMBER_OF_DISKS][SWAP_WORDS];//Bitmap of the swap slots of each swap disk, a set bit means the slot is free
+short SwapRefs[SWAP_SLOTS];//Number of swap map entries holding each slot, more than one after a fork
+char SwapWriting[SWAP_SLOTS];//Set from taking a slot for a write until the write ends, SwapRead waits for it
+unsigned int SwapVersion[SWAP_SLOTS];//Counts the writes to each slot, a prefetch drops a copy read before a write
+int FreeSwapCount = 0;//Number of free swap slots
+int SwapDiskFree[MAX_NUMBER_OF_DISKS];//Number of free swap slots of each swap disk
+int SwapDiskCount = SWAP_DISKS;//Number of disks used for swap
+int SwapDiskIds[MAX_NUMBER_OF_DISKS] = { 1, 2, 3, 4, 5, 6, 7, 0 };//Disk of each swap disk, disk 0 is used last
+int SwapNextDisk = 0;//Swap disk looked at first when several are equally busy
+int DiskPending[MAX_NUMBER_OF_DISKS];//Requests issued or waiting for each disk
+long DiskRequests[MAX_NUMBER_OF_DISKS];//Requests done by each disk
+long DiskTime[MAX_NUMBER_OF_DISKS];//Time from issuing to finishing the requests of each disk
+long SwapDiskReads[MAX_NUMBER_OF_DISKS];//Pages read from each swap disk
+long SwapDiskWrites[MAX_NUMBER_OF_DISKS];//Pages written to each swap disk
+long SwapMoves = 0;//Number of modified pages written to a less busy disk than their old slot
+long FirstFaultTime = -1;//Time of the first page fault
+
+//A swapped page kept compressed in the swap cache instead of on disk
+struct ZCacheEntry {
+	int pid;//-1 when the entry is free
+	int page;
+	int length;//Bytes used in data
+	long stamp;//When it was stored, the oldest entry is pushed out first
+	unsigned char data[ZCACHE_SLOT_BYTES];
+};
+
+struct ZCacheEntry ZCache[ZCACHE_MAX];//The pool of the swap cache, kept outside the physical memory
+short *ZCacheMap[14];//Entry of each logical page of each PCB in the swap cache (-1 when there is none)
+int ZCacheSize = 0;//Entries used for the swap cache (0 turns it off)
+long ZCacheStamp = 0;
+long ZCacheStores = 0;//Number of pages put in the swap cache
+long ZCacheRejects = 0;//Number of pages which didn't compress well enough and went to disk
+long ZCacheHits = 0;//Number of faults served from the swap cache
+long ZCachePushOuts = 0;//Number of cached pages written to disk to make room
+long ZCacheDropped = 0;//Number of cached pages of terminated processes thrown away
+long ZCacheBytesIn = 0;//Bytes of the pages put in the cache
+long ZCacheBytesOut = 0;//Bytes they were compressed to
+int *SwapMap[14];//Swap slot of each logical page of each PCB (-1 when there is none)
+char *PageWriting[14];//Set while a logical page of each PCB is being written out, a fault on it waits
+
+int PageoutEnabled = 1;//When set, the pageout daemon keeps a reserve of free pages (CLOCK policy only)
+int PageoutPID = -1;//PCB of the pageout daemon (-1 before it is started)
+long PageoutEvictions = 0;//Number of pages freed by the pageout daemon
+long FaultEvictions = 0;//Number of faults which had to evict a page themselves
+long FrameWaits = 0;//Number of times a fault found no page it could evict and waited
+int FrameWaiters = 0;//Number of processes sleeping in WaitForFrame now
+long WriteWaits = 0;//Number of times a fault or a swap read waited for a page being written out
+long SharedEvictions = 0;//Number of pages of shared areas written out
+long FaultHistogram[FAULT_BUCKETS];//Time from the start to the end of each page fault
+long FaultTimeTotal = 0;//Total time spent handling page faults
+long ProcessesReclaimed = 0;//Number of terminated processes whose memory was given back
+long ReclaimedFrames = 0;//Physical pages given back by terminated processes
+long ReclaimedSwapSlots = 0;//Swap slots given back by terminated processes
+long ReclaimedLeaves = 0;//Page table leaves freed with terminated processes
+long CowForks = 0;//Number of processes created by FORK_PROCESS
+long CowShared = 0;//Pages given to them copy-on-write
+long CowCopies = 0;//Pages copied on a write
+long CowReuses = 0;//Pages made writable again without a copy, the other processes had dropped them
+long FilesMapped = 0;//Number of MAP_FILE calls which mapped a file
+long MappedReads = 0;//Pages of mapped files read from their sectors by a fault
+long MappedWrites = 0;//Changed pages of mapped files written back to their sectors
+
+struct FaultStats {
+	long faults;//Number of page faults
+	long minor;//Faults served without reading the page back
+	long major;//Faults which read the page back from swap or the swap cache
+	long phase[FAULT_PHASES];//Time spent in each part of the faults
+};
+
+struct FaultStats ProcessFaults[14];//Fault statistics of each PCB
+struct FaultStats AllFaults;//Fault statistics of the whole system
+long FaultPhase[14][FAULT_PHASES];//Parts of the fault each PCB is handling now
+char *PhaseNames[FAULT_PHASES] = { "select", "swap-out", "swap-in", "update" };
+FILE *FaultTrace = NULL;//When set, every page fault is written to faults.csv
+
+//A swapped page the pageout daemon should read in ahead of a fault
+struct PrefetchRequest {
+	int pid;
+	int page;
+};
+
+struct PrefetchRequest PrefetchQueue[PREFETCH_QUEUE];//Ring of the prefetch requests
+int PrefetchHead = 0;
+int PrefetchCount = 0;
+int PrefetchWindow = PREFETCH_WINDOW;//Pages read around a swapped page on each side (0 turns prefetch off)
+long PrefetchOffUntil = 0;//Prefetch is off until this many page faults have happened
+long PrefetchReads = 0;//Number of pages read in ahead of a fault
+long PrefetchHits = 0;//Number of prefetched pages used before they were chosen again
+long PrefetchWasted = 0;//Number of prefetched pages chosen again without being used
+long PrefetchDropped = 0;//Number of prefetched pages faulted in by their owner while being read
+long PrefetchBackoffs = 0;//Number of times prefetch was turned off for a low hit rate
+int SampleHits = 0;//Hits in the current sample
+int SampleJudged = 0;//Prefetched pages judged in the current sample
+
+int PFFEnabled = 1;//When set, page fault frequency sets the quotas and suspends processes when memory is overcommitted
+long QuotaGrows = 0;//Number of times a quota grew
+long QuotaShrinks = 0;//Number of times a quota shrank
+long LoadSuspends = 0;//Number of processes suspended because memory was overcommitted
+long IdleResumes = 0;//Number of them resumed because nothing else could run
+long LocalEvictions = 0;//Number of victims taken from the faulting process itself
 //Some initializer and allocator
 
 /************************************************************************
@@ -196,31 +509,32 @@ void InterruptHandler(void) {
 
 		
 		int retpid = TimerReadPID(0);//Get the pid of the head of timer queue
+		if (retpid == -1)
+		{
+			//The timer can go off after its process has been woken up early
+			return;
+		}
 
 		//TimerQPrint();
 		//printf("Timer return PID: %d\n", retpid);
 
 
-		int time1 = Blocks[retpid].ptime;//Get the wake-up time of corresponding process
-		RemoveTimerItem(&Blocks[retpid]);//Remove the head item from timer queue
-		if (!TimerEmpty())
+		//Wake up every process whose wake-up time has come
+		while (retpid != -1 && Blocks[retpid].ptime <= nowtime)
 		{
-			//Timer is not empty
-			int pid2= TimerReadPID(0);//Get the pid of the head of timer queue now
-			int time2 = Blocks[pid2].ptime;//Get the wake-up time of corresponding process
-			int compare1 = abs(nowtime - time1);
-			int compare2 = abs(nowtime - time2);//Calculate the difference between these two wake-up time and current time
-			if (compare2<compare1)//Means that time2 nearer to current time.
-			{
-				//so we need to start one more timer to avoid the situation that an item in timer queue won't be removed.
-				mmio.Mode = Z502Start;
-				mmio.Field1 = abs(time2-time1);
-				mmio.Field2 = mmio.Field3 = 0;
-				MEM_WRITE(Z502Timer, &mmio);
-			}
-
+			RemoveTimerItem(&Blocks[retpid]);//Remove the head item from timer queue
+			Timestamp(retpid, EVENT_WAKE);
+			MakeReady(retpid);//Insert the removed PCB to ready queue with corresponding order
+			retpid = TimerReadPID(0);
+		}
+		if (retpid != -1)
+		{
+			//There is only one timer, start it again for the next process to wake up
+			mmio.Mode = Z502Start;
+			mmio.Field1 = Blocks[retpid].ptime - nowtime;
+			mmio.Field2 = mmio.Field3 = 0;
+			MEM_WRITE(Z502Timer, &mmio);
 		}
-		InsertReadyOrder(&Blocks[retpid], Blocks[retpid].order);//Insert the removed PCB to ready queue with corresponding order
 
 	}
 
@@ -242,7 +556,8 @@ void InterruptHandler(void) {
 				//This is only for avoiding faults, usually it won't be reached
 				int retpid2 = DiskReadPID(0);//Get the pid of the head of timer queue
 				RemoveDiskItem(&Blocks[retpid2]);//Remove the head item from timer queue
-				InsertReadyOrder(&Blocks[retpid2], Blocks[retpid2].order);//Insert the removed PCB to ready queue with corresponding order
+				Timestamp(retpid2, EVENT_WAKE);
+				MakeReady(retpid2);//Insert the removed PCB to ready queue with corresponding order
 				break;
 			}
 			else
@@ -252,7 +567,8 @@ void InterruptHandler(void) {
 				{
 					//Find the corresponding PCB
 					RemoveDiskItem(&Blocks[diskpid]);//Remove the corresponding item from timer queue
-					InsertReadyOrder(&Blocks[diskpid], Blocks[diskpid].order);//Insert the removed PCB to ready queue with corresponding order
+					Timestamp(diskpid, EVENT_WAKE);
+					MakeReady(diskpid);//Insert the removed PCB to ready queue with corresponding order
 					break;
 				}
 				else
@@ -304,33 +620,13 @@ void FaultHandler(void) {
 
 	if (DeviceID == 2)
 	{
-		if (memoryinit == 0)
-		{
-			for (int i = 0; i < 64; i++)
-			{
-				MemoryOwner[i] = -1;
-				MemoryState[i] = 4;
-			}
-			memoryinit = 1;
-		}
-
-		if (initswap == 0)
-		{
-			initSwap();
-			initswap = 1;
-		}
 		//printf("\n\nInvaild memory!\n\n");
-		mmio.Mode = Z502GetPageTable;
-		mmio.Field1 = mmio.Field2 = mmio.Field3 = 0;
-		MEM_READ(Z502Context, &mmio);
-		PAGE_TBL_ADDR = (short *)mmio.Field1;   // Gives us the page table
-		// Set to VALID the logical page 0 and have it point at physical
-		// frame 0.
-		if (Status >= 1024)
-		{
-			mmio.Mode = Z502Action;
-			mmio.Field1 = mmio.Field2 = mmio.Field3 = 0;
-			MEM_WRITE(Z502Halt, &mmio);
+		//The page table is reached through the PCB of the faulting process,
+		//nothing here is shared with faults on other processors but the
+		//physical pages, which are taken under their locks
+		if (Status >= NUMBER_VIRTUAL_PAGES)
+		{
+			HaltSystem();
 		}
 		else
 		{
@@ -346,35 +642,126 @@ void FaultHandler(void) {
 				if (Blocks[countcurrent].Context == mmio.Field1)
 				{
 					//printf("\ngivebit:%d\n", Blocks[countcurrent].givebit);
-					if (checkFull())
+					PageFaults++;
+					mmio.Mode = Z502ReturnValue;
+					mmio.Field1 = mmio.Field2 = mmio.Field3 = mmio.Field4 = 0;
+					MEM_READ(Z502Clock, &mmio);
+					long faultstart = mmio.Field1;//Used for the fault latency histogram
+					if (FirstFaultTime == -1)
+					{
+						FirstFaultTime = faultstart;
+					}
+					int major = 0;//Set when the page is read back
+					for (int k = 0; k < FAULT_PHASES; k++)
+					{
+						FaultPhase[countcurrent][k] = 0;
+					}
+					if (PFFEnabled)
+					{
+						AdjustQuota(countcurrent);
+					}
+					while (PageWriting[countcurrent][Status])
+					{
+						WaitForWrite(countcurrent);//Evicted but not on disk or in the file yet
+					}
+					int sindex;
+					int sarea = findSharedArea(countcurrent, Status, &sindex);//Check if the page is in a shared area
+					int findex;
+					int fmap = findFileMapping(countcurrent, Status, &findex);//Check if the page is in a mapped file
+					int pn = -1;
+					//A fault on a valid page is a write to a page shared copy-on-write,
+					//or a page whose eviction was undone while it waited (BreakCow leaves it)
+					int cow = (PageValue(countcurrent, Status) & PTBL_VALID_BIT) != 0;
+					if (!cow && sarea == -1)
+					{
+						pn = getFreePhysicalPage();//-1 when another fault took the last one
+					}
+					if (cow)
+					{
+						BreakCow(countcurrent, Status);
+					}
+					else if (sarea != -1)
 					{
-						if (PAGE_TBL_ADDR[Status] == 2)
+						major = SharedFault(countcurrent, Status, sarea, sindex);
+					}
+					else if (pn == -1)
+					{
+						FaultEvictions++;
+						int swapped = (PageValue(countcurrent, Status) == 2);
+						long outstart = ReadClock();
+						int victim = WriteVictim(countcurrent, Status);
+						//WriteVictim has counted the time of choosing the victim itself
+						FaultPhase[countcurrent][PHASE_OUT] += ReadClock() - outstart
+							- FaultPhase[countcurrent][PHASE_SELECT];
+						if (swapped)
 						{
-							int victim=WriteVictim(countcurrent, Status);
+							long instart = ReadClock();
 							ReadBack(countcurrent,victim,Status);
+							FaultPhase[countcurrent][PHASE_IN] += ReadClock() - instart;
+							major = 1;
+							PrefetchAround(countcurrent, Status);
 						}
-						else
+						else if (fmap != -1)
 						{
-							//printf("\nanyone there?\n");
-							WriteVictim(countcurrent,Status);
+							long instart = ReadClock();
+							ReadMappedPage(countcurrent, fmap, findex, victim);
+							FaultPhase[countcurrent][PHASE_IN] += ReadClock() - instart;
+							major = 1;
 						}
-						
-						
+						MemoryBusy[victim] = 0;//The page holds its new content now
 
 					}
 					else
 					{
-						int pn=getFreePhysicalPage();
-						PAGE_TBL_ADDR[Status] = (UINT16)PTBL_VALID_BIT + (UINT16)pn;
+						int swapped = (PageValue(countcurrent, Status) == 2);//The pageout daemon may have put this page in swap
+						*PageEntry(countcurrent, Status) = (UINT16)PTBL_VALID_BIT + (UINT16)pn;
 						Blocks[countcurrent].Memory[pn] = Status;
 						MemoryOwner[pn] = countcurrent;
 						MemoryOrder[pn] = clock;
 						MemoryAddress[pn]=Status;
-						MemoryPrinter();
+						if (swapped)
+						{
+							MemoryBusy[pn] = 1;
+							long instart = ReadClock();
+							ReadBack(countcurrent, pn, Status);
+							FaultPhase[countcurrent][PHASE_IN] += ReadClock() - instart;
+							major = 1;
+							MemoryBusy[pn] = 0;
+							PrefetchAround(countcurrent, Status);
+						}
+						else if (fmap != -1)
+						{
+							MemoryBusy[pn] = 1;
+							long instart = ReadClock();
+							ReadMappedPage(countcurrent, fmap, findex, pn);
+							FaultPhase[countcurrent][PHASE_IN] += ReadClock() - instart;
+							major = 1;
+							MemoryBusy[pn] = 0;
+						}
 						MemoryState[pn] = 1;
+						MemoryPrinter(pn);
 						clock++;
 					}
 
+					if (FreeFrameCount < PAGEOUT_LOW)
+					{
+						WakePageout();//Free some pages before the next faults need them
+					}
+
+					mmio.Mode = Z502ReturnValue;
+					mmio.Field1 = mmio.Field2 = mmio.Field3 = mmio.Field4 = 0;
+					MEM_READ(Z502Clock, &mmio);
+					long faulttime = mmio.Field1 - faultstart;
+					int bucket = 0;
+					while (bucket < FAULT_BUCKETS - 1 && faulttime >= (1L << bucket))
+					{
+						bucket++;
+					}
+					FaultHistogram[bucket]++;
+					FaultTimeTotal += faulttime;
+					RecordFault(countcurrent, Status, major, faultstart, faulttime);
+					LoadControl(countcurrent);
+
 					break;
 				}
 			}
@@ -388,33 +775,131 @@ void FaultHandler(void) {
 } // End of FaultHandler
 
 /************************************************************************
- MemoryPrinter
- Function used for printing memory status.
+ ReadClock
+ Function used for reading the simulated time.
  ************************************************************************/
-void MemoryPrinter() {
-	memset(&MPData, 0, sizeof(MP_INPUT_DATA));  // Good practice - clean up
+long ReadClock() {
+	MEMORY_MAPPED_IO mmio;
+	mmio.Mode = Z502ReturnValue;
+	mmio.Field1 = mmio.Field2 = mmio.Field3 = mmio.Field4 = 0;
+	MEM_READ(Z502Clock, &mmio);
+	return mmio.Field1;
+}
 
-	for (int j = 0; j < NUMBER_PHYSICAL_PAGES; j++) {
-		if (MemoryOwner[j] == -1)
+/************************************************************************
+ RecordFault
+ Function used at the end of a page fault for adding its parts to the
+ statistics of its process and of the system, and to the fault trace.
+ The time not spent choosing a victim, writing it out or reading the
+ page back is counted as the update.
+ ************************************************************************/
+void RecordFault(int pid, int page, int major, long start, long faulttime) {
+	long *phase = FaultPhase[pid];
+	phase[PHASE_UPDATE] = faulttime - phase[PHASE_SELECT] - phase[PHASE_OUT] - phase[PHASE_IN];
+	struct FaultStats *stats[2] = { &ProcessFaults[pid], &AllFaults };
+	for (int s = 0; s < 2; s++)
+	{
+		stats[s]->faults++;
+		if (major)
 		{
-			MPData.frames[j].InUse = FALSE;
+			stats[s]->major++;
 		}
 		else
 		{
-			MPData.frames[j].InUse = TRUE;
-			MPData.frames[j].Pid = MemoryOwner[j];
-			MPData.frames[j].LogicalPage = MemoryAddress[j];
-			MPData.frames[j].State = MemoryState[j];
+			stats[s]->minor++;
+		}
+		for (int k = 0; k < FAULT_PHASES; k++)
+		{
+			stats[s]->phase[k] += phase[k];
 		}
-		
-
 	}
+	if (FaultTrace != NULL)
+	{
+		fprintf(FaultTrace, "%ld,%d,%s,%d,%s,%ld,%ld,%ld,%ld,%ld\n", start, (int)Blocks[pid].pid,
+			Blocks[pid].name, page, major ? "major" : "minor", phase[PHASE_SELECT],
+			phase[PHASE_OUT], phase[PHASE_IN], phase[PHASE_UPDATE], faulttime);
+	}
+}
+
+/************************************************************************
+ MemoryPrinter
+ Function used for printing memory status.
+ ************************************************************************/
+void MemoryPrinter(int frame) {
+	UpdateMPFrame(frame);
 	if (memoryprint > 0)
 	{
-		MPPrintLine(&MPData);
-		memoryprint--;
+		if (!MPDeltaMode)
+		{
+			MPPrintLine(&MPData);
+			memoryprint--;
+		}
+		else if (MPChangedCount > 0)
+		{
+			PrintMPChanges();
+			memoryprint--;
+		}
+	}
+}
+
+/************************************************************************
+ UpdateMPFrame
+ Function used for bringing the entry of one physical page in MPData up
+ to date.  A page whose owner, logical page or state is different from
+ its entry is added to the pages changed since the last print.
+ ************************************************************************/
+void UpdateMPFrame(int frame) {
+	MP_FRAME_DATA now;
+	memset(&now, 0, sizeof(MP_FRAME_DATA));
+	if (MemoryOwner[frame] != -1)
+	{
+		now.InUse = TRUE;
+		now.Pid = MemoryOwner[frame];
+		now.LogicalPage = MemoryAddress[frame];
+		now.State = MemoryState[frame];
 	}
-	
+	if (memcmp(&now, &MPData.frames[frame], sizeof(MP_FRAME_DATA)) == 0)
+	{
+		return;
+	}
+	MPData.frames[frame] = now;
+	if (!MPChanged[frame])
+	{
+		MPChanged[frame] = 1;
+		MPChangedList[MPChangedCount++] = frame;
+	}
+}
+
+/************************************************************************
+ PrintMPChanges
+ Function used by the delta mode of the memory printer for printing
+ only the physical pages changed since the last print, as
+ page=pid/logical page/state, or page=free.
+ ************************************************************************/
+void PrintMPChanges() {
+	char line[120];
+	int length = sprintf(line, "Memory changes:");
+	for (int i = 0; i < MPChangedCount; i++)
+	{
+		int frame = MPChangedList[i];
+		MP_FRAME_DATA *f = &MPData.frames[frame];
+		if (length > 100)
+		{
+			aprintf("%s\n", line);
+			length = sprintf(line, "               ");
+		}
+		if (f->InUse)
+		{
+			length += sprintf(line + length, " %d=%d/%d/%d", frame, f->Pid, f->LogicalPage, f->State);
+		}
+		else
+		{
+			length += sprintf(line + length, " %d=free", frame);
+		}
+		MPChanged[frame] = 0;
+	}
+	aprintf("%s\n", line);
+	MPChangedCount = 0;
 }
 
 /************************************************************************
@@ -473,217 +958,3272 @@ void WasteTime() {
 
 }
 
+/************************************************************************
+ ctz64
+ Function used for counting the trailing zero bits of a 64-bit word.
+ The word must not be 0.
+ ************************************************************************/
+int ctz64(unsigned long long word) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_ctzll(word);
+#else
+	int n = 0;
+	while ((word & 1) == 0)
+	{
+		word >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/************************************************************************
+ initFrames
+ Function used for marking all the physical pages free.
+ ************************************************************************/
+void initFrames() {
+	for (int i = 0; i < NUMBER_PHYSICAL_PAGES; i++)
+	{
+		MemoryOwner[i] = -1;
+		MemoryState[i] = 4;
+		MemoryShared[i] = 0;
+		MemoryArea[i] = -1;
+		MemorySwap[i] = -1;
+		MemoryCow[i] = 0;
+	}
+	for (int i = 0; i < FRAME_WORDS; i++)
+	{
+		FreeFrames[i] = 0;
+	}
+	for (int i = 0; i < NUMBER_PHYSICAL_PAGES; i++)
+	{
+		FreeFrames[i / 64] |= 1ULL << (i % 64);
+	}
+	FreeFrameCount = NUMBER_PHYSICAL_PAGES;
+}
+
+/************************************************************************
+ initMemoryTables
+ Function used for allocating the tables sized by the memory of the
+ hardware, which is only known once the hardware has started.
+ ************************************************************************/
+void initMemoryTables() {
+	MemoryOwner = (int *)calloc(NUMBER_PHYSICAL_PAGES, sizeof(int));
+	MemoryOrder = (int *)calloc(NUMBER_PHYSICAL_PAGES, sizeof(int));
+	MemoryAddress = (int *)calloc(NUMBER_PHYSICAL_PAGES, sizeof(int));
+	MemoryState = (int *)calloc(NUMBER_PHYSICAL_PAGES, sizeof(int));
+	MemoryShared = (int *)calloc(NUMBER_PHYSICAL_PAGES, sizeof(int));
+	MemoryArea = (int *)calloc(NUMBER_PHYSICAL_PAGES, sizeof(int));
+	MemoryBusy = (int *)calloc(NUMBER_PHYSICAL_PAGES, sizeof(int));
+	MemorySwap = (int *)calloc(NUMBER_PHYSICAL_PAGES, sizeof(int));
+	MemoryPrefetched = (int *)calloc(NUMBER_PHYSICAL_PAGES, sizeof(int));
+	MemoryCow = (int *)calloc(NUMBER_PHYSICAL_PAGES, sizeof(int));
+	for (int i = 0; i < 14; i++)
+	{
+		SwapMap[i] = (int *)calloc(NUMBER_VIRTUAL_PAGES, sizeof(int));
+		ZCacheMap[i] = (short *)calloc(NUMBER_VIRTUAL_PAGES, sizeof(short));
+		PageWriting[i] = (char *)calloc(NUMBER_VIRTUAL_PAGES, sizeof(char));
+	}
+}
+
 /************************************************************************
  getFreePhysicalPage
  Function used for getting a free physical page.
+ The page is taken from the free bitmap, the first non-empty word gives
+ it with one count-trailing-zeros.
+ return -1 if there is no free page.
  ************************************************************************/
 int getFreePhysicalPage() {
-	for (int i = 0; i < 64; i++)
+	INT32 Result;
+	int frame = -1;
+	if (FreeFrameCount == 0)
+	{
+		return -1;
+	}
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + FREE_FRAMES_LOCK, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&Result);
+	for (int i = 0; i < FRAME_WORDS; i++)
 	{
-		if (MemoryOwner[i] == -1)
+		if (FreeFrames[i] != 0)
 		{
-			return i;
+			int bit = ctz64(FreeFrames[i]);
+			FreeFrames[i] &= ~(1ULL << bit);//Mark it used
+			FreeFrameCount--;
+			frame = i * 64 + bit;
+			break;
 		}
 	}
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + FREE_FRAMES_LOCK, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&Result);
+	return frame;
+}
 
-	return -1;
+/************************************************************************
+ LockFrame, UnlockFrame
+ Functions used for the lock of a physical page.
+ The physical pages share FRAME_LOCKS locks, so faults on different
+ processors seldom wait for the same one.
+ ************************************************************************/
+void LockFrame(int frame) {
+	INT32 Result;
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + FRAME_LOCK_BASE + frame % FRAME_LOCKS,
+		DO_LOCK, SUSPEND_UNTIL_LOCKED, &Result);
+}
+
+void UnlockFrame(int frame) {
+	INT32 Result;
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + FRAME_LOCK_BASE + frame % FRAME_LOCKS,
+		DO_UNLOCK, SUSPEND_UNTIL_LOCKED, &Result);
 }
 
+/************************************************************************
+ ClaimFrame
+ Function used for taking a physical page in use away from its owner.
+ Under the lock of the page it must still be in use and not busy; it is
+ then marked busy, so no other fault and not the pageout daemon can
+ choose it until the new owner is done with it.
+ return 1 if the page was claimed.
+ ************************************************************************/
+int ClaimFrame(int frame) {
+	int claimed = 0;
+	LockFrame(frame);
+	if (MemoryOwner[frame] != -1 && !MemoryBusy[frame])
+	{
+		MemoryBusy[frame] = 1;
+		claimed = 1;
+	}
+	UnlockFrame(frame);
+	return claimed;
+}
 
 /************************************************************************
- getVictim
- Function used for finding a victim page.
+ NewPageTable
+ Function used for allocating the page directory of a new process.
+ All the leaves start out missing.
  ************************************************************************/
-int getVictim(int pid) {
-	int victim=-1;
-	for (int i = 0; i < 64; i++)
+short **NewPageTable() {
+	return (short **)calloc(PTBL_DIRECTORY_ENTRIES, sizeof(short *));
+}
+
+/************************************************************************
+ PageEntry
+ Function used for finding the page table entry of a logical page.
+ The page table has two levels, the leaf holding the entry is allocated
+ the first time one of its pages is needed.
+ ************************************************************************/
+short *PageEntry(int pid, int page) {
+	short **leaf = &Blocks[pid].PageTable[page / PTBL_LEAF_PAGES];
+	if (*leaf == NULL)
+	{
+		*leaf = (short *)calloc(PTBL_LEAF_PAGES, sizeof(short));
+		Blocks[pid].leaves++;
+	}
+	return &(*leaf)[page % PTBL_LEAF_PAGES];
+}
+
+/************************************************************************
+ PageValue
+ Function used for reading the page table entry of a logical page
+ without allocating its leaf.
+ return the entry, 0 if its leaf doesn't exist.
+ ************************************************************************/
+short PageValue(int pid, int page) {
+	if (Blocks[pid].PageTable == NULL)
+	{
+		return 0;//Freed with a terminated process
+	}
+	short *leaf = Blocks[pid].PageTable[page / PTBL_LEAF_PAGES];
+	if (leaf == NULL)
+	{
+		return 0;
+	}
+	return leaf[page % PTBL_LEAF_PAGES];
+}
+
+/************************************************************************
+ InvalidateTLB
+ Function used after a valid page table entry is taken away.
+ The hardware drops the translation from the TLB of every processor.
+ ************************************************************************/
+void InvalidateTLB(int pid, int page) {
+	MEMORY_MAPPED_IO mmio;
+	mmio.Mode = Z502InvalidateTLB;
+	mmio.Field1 = Blocks[pid].Context;
+	mmio.Field2 = page;
+	mmio.Field3 = mmio.Field4 = 0;
+	MEM_WRITE(Z502Context, &mmio);
+}
+
+/************************************************************************
+ releasePhysicalPage
+ Function used for giving a physical page back to the free bitmap.
+ ************************************************************************/
+void releasePhysicalPage(int frame) {
+	INT32 Result;
+	unsigned long long bit = 1ULL << (frame % 64);
+	if (MemorySwap[frame] != -1)
+	{
+		//The copy in swap is not needed any more
+		releaseSwap(MemorySwap[frame]);
+		SwapMap[MemoryOwner[frame]][MemoryAddress[frame]] = -1;
+		MemorySwap[frame] = -1;
+	}
+	MemoryOwner[frame] = -1;
+	MemoryState[frame] = 4;
+	MemoryShared[frame] = 0;
+	MemoryArea[frame] = -1;
+	MemoryPrefetched[frame] = 0;
+	MemoryCow[frame] = 0;
+	UpdateMPFrame(frame);
+	//Only now the page can be handed out again
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + FREE_FRAMES_LOCK, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&Result);
+	if ((FreeFrames[frame / 64] & bit) == 0)
+	{
+		FreeFrames[frame / 64] |= bit;
+		FreeFrameCount++;
+	}
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + FREE_FRAMES_LOCK, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&Result);
+}
+
+
+/************************************************************************
+ JudgePrefetch
+ Function used for counting a prefetched page as a hit or as wasted.
+ After every PREFETCH_SAMPLE pages the hit rate is checked, and when it
+ is too low prefetch is turned off for PREFETCH_BACKOFF page faults.
+ ************************************************************************/
+void JudgePrefetch(int frame, int hit) {
+	MemoryPrefetched[frame] = 0;
+	if (hit)
+	{
+		PrefetchHits++;
+		SampleHits++;
+	}
+	else
+	{
+		PrefetchWasted++;
+	}
+	SampleJudged++;
+	if (SampleJudged == PREFETCH_SAMPLE)
 	{
-		if (MemoryOwner[i] == pid)
+		if (SampleHits < PREFETCH_MIN_HITS)
 		{
-			if (victim == -1)
-			{
-				victim = i;
-			}
-			else if (MemoryOrder[i] < MemoryOrder[victim])
-			{
-				victim = i;
-			}
+			PrefetchOffUntil = PageFaults + PREFETCH_BACKOFF;
+			PrefetchBackoffs++;
+		}
+		SampleHits = 0;
+		SampleJudged = 0;
+	}
+}
+
+/************************************************************************
+ AdjustQuota
+ Function used at each page fault for setting the quota of a process
+ from its page fault frequency.
+ The time between two faults is measured in CPU time of the process.
+ A process faulting again soon gets a larger quota, a process which
+ hasn't faulted for a long time gives a page back.
+ ************************************************************************/
+void AdjustQuota(int pid) {
+	MEMORY_MAPPED_IO mmio;
+	mmio.Mode = Z502ReturnValue;
+	mmio.Field1 = mmio.Field2 = mmio.Field3 = mmio.Field4 = 0;
+	MEM_READ(Z502Clock, &mmio);
+	long vtime = Blocks[pid].cputime + (mmio.Field1 - Blocks[pid].dtime);//CPU time used until now
+	long interval = vtime - Blocks[pid].lastfault;
+	Blocks[pid].lastfault = vtime;
+	if (Blocks[pid].quota == 0)
+	{
+		Blocks[pid].quota = PFF_INITIAL;
+	}
+	else if (interval < PFF_LOW && Blocks[pid].quota < PFF_LIMIT)
+	{
+		Blocks[pid].quota += PFF_STEP;
+		if (Blocks[pid].quota > PFF_LIMIT)
+		{
+			Blocks[pid].quota = PFF_LIMIT;
+		}
+		QuotaGrows++;
+	}
+	else if (interval > PFF_HIGH && Blocks[pid].quota > PFF_MIN)
+	{
+		Blocks[pid].quota--;
+		QuotaShrinks++;
+	}
+}
+
+/************************************************************************
+ MemoryDemand
+ Function used for adding up the quotas of the processes which are
+ using memory and aren't suspended for it.
+ ************************************************************************/
+int MemoryDemand() {
+	int demand = 0;
+	for (int i = 0; i < PID; i++)
+	{
+		if (Blocks[i].status != 0 && !Blocks[i].memsuspend)
+		{
+			demand += Blocks[i].quota;
+		}
+	}
+	return demand;
+}
+
+/************************************************************************
+ LoadControl
+ Function used at the end of a page fault.
+ When the quotas of the running processes don't fit in memory, the
+ faulting process is suspended until others finish or give pages back,
+ so the rest stop thrashing. The main process is never suspended, nor
+ the last process which can run again by itself: one waiting for a
+ message may wait for a suspended one.
+ ************************************************************************/
+void LoadControl(int pid) {
+	if (!PFFEnabled)
+	{
+		return;
+	}
+	if (MemoryDemand() <= PFF_LIMIT)
+	{
+		ResumeLoad();
+		return;
+	}
+	int runnable = 0;//Other processes using memory which don't need anyone to run again
+	for (int i = 1; i < PID; i++)
+	{
+		if (i != pid && i != PageoutPID && Blocks[i].status != 0 && !Blocks[i].memsuspend
+			&& Blocks[i].quota > 0 && (Blocks[i].state == STATE_READY
+			|| Blocks[i].state == STATE_TIMER_WAIT || Blocks[i].state == STATE_DISK_WAIT))
+		{
+			runnable++;
 		}
 	}
-	return victim;
+	if (pid == 0 || runnable == 0)
+	{
+		return;
+	}
+	Blocks[pid].memsuspend = 1;
+	Blocks[pid].quota = PFF_INITIAL;//Start small again when resumed
+	Blocks[pid].state = STATE_SUSPENDED;
+	Blocks[pid].queue = QUEUE_SUSPEND;
+	InsertSuspendTail(&Blocks[pid]);
+	LoadSuspends++;
+	CallSchedulePrinter(8, Blocks[pid].pid);
+	dispatcher();//Comes back when it is resumed
+}
+
+/************************************************************************
+ ResumeLoad
+ Function used for resuming the processes suspended by LoadControl
+ while their quotas fit in memory again.
+ One is always resumed when no other process is using memory.
+ ************************************************************************/
+void ResumeLoad() {
+	for (int i = 1; i < PID; i++)
+	{
+		if (Blocks[i].memsuspend && Blocks[i].status != 0 && Blocks[i].state == STATE_SUSPENDED)
+		{
+			int demand = MemoryDemand();
+			if (demand > 0 && demand + Blocks[i].quota > PFF_LIMIT)
+			{
+				return;
+			}
+			ResumeSuspended(i);
+		}
+	}
+}
+
+/************************************************************************
+ ResumeSuspended
+ Function used for putting a process suspended by LoadControl back on
+ the ready queue.
+ ************************************************************************/
+void ResumeSuspended(int pid) {
+	Blocks[pid].memsuspend = 0;
+	RemoveSuspendItem(&Blocks[pid]);
+	Blocks[pid].state = STATE_READY;
+	MakeReady(pid);
+	CallSchedulePrinter(9, Blocks[pid].pid);
+}
+
+/************************************************************************
+ IdleMemory
+ Function used by the dispatcher while the ready queue is empty.
+ Nothing can run, so a process suspended by LoadControl is resumed even
+ when its quota doesn't fit, and the pageout daemon is woken when
+ processes wait for pages and none is free. Otherwise the processes
+ waiting for them would never run again.
+ ************************************************************************/
+void IdleMemory() {
+	if (FrameWaiters > 0 && FreeFrameCount == 0 && getCurrentPID() != PageoutPID)
+	{
+		WakePageout();//Not when the daemon itself has just found nothing to free
+	}
+	for (int i = 1; i < PID; i++)
+	{
+		if (Blocks[i].memsuspend && Blocks[i].status != 0 && Blocks[i].state == STATE_SUSPENDED)
+		{
+			IdleResumes++;
+			ResumeSuspended(i);
+			return;
+		}
+	}
+}
+
+/************************************************************************
+ getVictim
+ Function used for finding a victim page.
+ With POLICY_FIFO the oldest page of the faulting process is chosen.
+ With POLICY_CLOCK the clock hand sweeps all the physical pages: a page
+ whose referenced bit is set in its owner's page table gets a second
+ chance (the bit is cleared), the first page without it is chosen. A page
+ of a shared area gets a second chance when any process mapping it has
+ used it, and is only taken when no process has to give back its own.
+ A process with no page of its own left under POLICY_FIFO takes the
+ oldest page of all.
+ The page is claimed before it is returned, see ClaimFrame.
+ return -1 if every page is busy.
+ ************************************************************************/
+int getVictim(int pid) {
+	int victim=-1;
+	if (ReplacePolicy == POLICY_CLOCK)
+	{
+		int resident[14];
+		int local = 0;
+		int overquota = 0;
+		if (PFFEnabled)
+		{
+			for (int i = 0; i < 14; i++)
+			{
+				resident[i] = 0;
+			}
+			for (int i = 0; i < NUMBER_PHYSICAL_PAGES; i++)
+			{
+				if (MemoryOwner[i] != -1 && MemoryShared[i] == 0)
+				{
+					resident[MemoryOwner[i]]++;
+				}
+			}
+			//A process at its quota replaces its own pages, otherwise pages over the quotas of others go first
+			local = (pid >= 0 && resident[pid] >= Blocks[pid].quota);
+			overquota = !local;
+		}
+		//Two rounds are enough, all the referenced bits are cleared in the first one,
+		//two more are used when no process is over its quota
+		for (int n = 0; n < 4 * NUMBER_PHYSICAL_PAGES; n++)
+		{
+			int i = ClockHand;
+			ClockHand = (ClockHand + 1) % NUMBER_PHYSICAL_PAGES;
+			if (n == 2 * NUMBER_PHYSICAL_PAGES)
+			{
+				local = overquota = 0;
+			}
+			if (MemoryOwner[i] == -1 || MemoryBusy[i])
+			{
+				continue;
+			}
+			int owner = MemoryOwner[i];
+			int referenced;
+			if (MemoryShared[i] > 0)
+			{
+				if (local || overquota)
+				{
+					continue;
+				}
+				referenced = SharedReferenced(i);//Clears the bit of every process mapping it
+			}
+			else
+			{
+				if (local && owner != pid)
+				{
+					continue;
+				}
+				if (overquota && resident[owner] <= Blocks[owner].quota
+					&& !Blocks[owner].memsuspend && Blocks[owner].status != 0)
+				{
+					continue;
+				}
+				UINT16 *pte = (UINT16 *)PageEntry(MemoryOwner[i], MemoryAddress[i]);
+				referenced = (*pte & PTBL_REFERENCED_BIT) != 0;
+				*pte &= ~PTBL_REFERENCED_BIT;
+			}
+			if (referenced)
+			{
+				//Give it a second chance
+				if (MemoryPrefetched[i])
+				{
+					JudgePrefetch(i, 1);//Used since it was read in
+				}
+			}
+			else
+			{
+				if (!ClaimFrame(i))
+				{
+					continue;//Chosen by a fault on another processor meanwhile
+				}
+				if (MemoryPrefetched[i])
+				{
+					JudgePrefetch(i, 0);//Never used
+				}
+				if (owner == pid)
+				{
+					LocalEvictions++;
+				}
+				return i;
+			}
+		}
+		return -1;
+	}
+	for (int i = 0; i < NUMBER_PHYSICAL_PAGES; i++)
+	{
+		if (MemoryOwner[i] == pid && MemoryShared[i] == 0 && !MemoryBusy[i])
+		{
+			if (victim == -1)
+			{
+				victim = i;
+			}
+			else if (MemoryOrder[i] < MemoryOrder[victim])
+			{
+				victim = i;
+			}
+		}
+	}
+	if (victim == -1)
+	{
+		//No page of its own, the others hold all the memory
+		for (int i = 0; i < NUMBER_PHYSICAL_PAGES; i++)
+		{
+			if (MemoryOwner[i] != -1 && !MemoryBusy[i]
+				&& (victim == -1 || MemoryOrder[i] < MemoryOrder[victim]))
+			{
+				victim = i;
+			}
+		}
+	}
+	if (victim != -1 && !ClaimFrame(victim))
+	{
+		return getVictim(pid);//Chosen by a fault on another processor meanwhile, look again
+	}
+	return victim;
+}
+
+/************************************************************************
+ initSwap
+ Function used for initializing the swap area.
+ All the slots are free and no page of any process is in swap.
+ ************************************************************************/
+void initSwap() {
+	FreeSwapCount = 0;
+	for (int d = 0; d < MAX_NUMBER_OF_DISKS; d++)
+	{
+		for (int i = 0; i < SWAP_WORDS; i++)
+		{
+			FreeSwap[d][i] = 0;
+		}
+		SwapDiskFree[d] = 0;
+		if (d >= SwapDiskCount)
+		{
+			continue;
+		}
+		for (int i = 0; i < SWAP_DISK_SLOTS; i++)
+		{
+			FreeSwap[d][i / 64] |= 1ULL << (i % 64);
+		}
+		SwapDiskFree[d] = SWAP_DISK_SLOTS;
+		FreeSwapCount += SWAP_DISK_SLOTS;
+	}
+	for (int i = 0; i < 14; i++)
+	{
+		for (int j = 0; j < NUMBER_VIRTUAL_PAGES; j++)
+		{
+			SwapMap[i][j] = -1;
+			ZCacheMap[i][j] = -1;
+		}
+	}
+	for (int i = 0; i < ZCACHE_MAX; i++)
+	{
+		ZCache[i].pid = -1;
+	}
+}
+
+/************************************************************************
+ SwapDisk, SwapSector
+ Functions used for finding where a swap slot is stored.
+ Slots are numbered SWAP_SECTORS apart on each swap disk, slot / SWAP_SECTORS
+ is the swap disk and slot % SWAP_SECTORS the slot in its swap area.  A slot
+ takes SWAP_PAGE_SECTORS sectors, so only SWAP_DISK_SLOTS of them are used.
+ ************************************************************************/
+int SwapDisk(int slot) {
+	return SwapDiskIds[slot / SWAP_SECTORS];
+}
+
+int SwapSector(int slot) {
+	return SWAP_START_SECTOR + (slot % SWAP_SECTORS) * SWAP_PAGE_SECTORS;
+}
+
+/************************************************************************
+ SwapWrite, SwapRead
+ Functions used for moving one page between a buffer and its swap slot,
+ a sector at a time. The disk doesn't order the requests, so a read of
+ a slot taken for a write waits until that write has ended.
+ ************************************************************************/
+void SwapWrite(int slot, char *data) {
+	MEMORY_MAPPED_IO mmio;
+	for (int i = 0; i < SWAP_PAGE_SECTORS; i++)
+	{
+		mmio.Mode = Z502DiskWrite;
+		mmio.Field1 = SwapDisk(slot);
+		mmio.Field2 = SwapSector(slot) + i;
+		mmio.Field3 = (long)(data + i * DISK_SECTOR_SIZE);
+		DoDisk(mmio);
+	}
+	SwapDiskWrites[slot / SWAP_SECTORS]++;
+	SwapVersion[slot]++;
+	SwapWriting[slot] = 0;
+}
+
+void SwapRead(int slot, char *data) {
+	MEMORY_MAPPED_IO mmio;
+	while (SwapWriting[slot])
+	{
+		WaitForWrite(getCurrentPID());//The disk holds nothing valid until the write ends
+	}
+	for (int i = 0; i < SWAP_PAGE_SECTORS; i++)
+	{
+		mmio.Mode = Z502DiskRead;
+		mmio.Field1 = SwapDisk(slot);
+		mmio.Field2 = SwapSector(slot) + i;
+		mmio.Field3 = (long)(data + i * DISK_SECTOR_SIZE);
+		DoDisk(mmio);
+	}
+	SwapDiskReads[slot / SWAP_SECTORS]++;
+}
+
+/************************************************************************
+ releaseSwap
+ Function used for giving a swap slot back to the free bitmap.
+ ************************************************************************/
+void releaseSwap(int slot) {
+	int d = slot / SWAP_SECTORS;
+	int i = slot % SWAP_SECTORS;
+	unsigned long long bit = 1ULL << (i % 64);
+	if (SwapRefs[slot] > 1)
+	{
+		SwapRefs[slot]--;//Still held by another process
+		return;
+	}
+	SwapRefs[slot] = 0;
+	if ((FreeSwap[d][i / 64] & bit) == 0)
+	{
+		FreeSwap[d][i / 64] |= bit;
+		SwapDiskFree[d]++;
+		FreeSwapCount++;
+	}
+}
+
+/************************************************************************
+ LeastBusySwapDisk
+ Function used for choosing the swap disk a page is written to.
+ The swap disk with the fewest requests pending which still has a free
+ slot is chosen; between equally busy ones an idle disk is preferred,
+ then they are taken in turn so the slots are striped over all of them.
+ return the swap disk, -1 if no swap disk has a free slot.
+ ************************************************************************/
+int LeastBusySwapDisk() {
+	MEMORY_MAPPED_IO mmio;
+	int best = -1;
+	int bestload = 0;
+	for (int k = 0; k < SwapDiskCount; k++)
+	{
+		int d = (SwapNextDisk + k) % SwapDiskCount;
+		if (SwapDiskFree[d] == 0)
+		{
+			continue;
+		}
+		mmio.Mode = Z502Status;
+		mmio.Field1 = SwapDiskIds[d];
+		mmio.Field2 = mmio.Field3 = 0;
+		MEM_READ(Z502Disk, &mmio);
+		//Twice the pending requests, plus one if the disk is working now
+		int load = 2 * DiskPending[SwapDiskIds[d]] + (mmio.Field2 == DEVICE_IN_USE);
+		if (best == -1 || load < bestload)
+		{
+			best = d;
+			bestload = load;
+		}
+	}
+	if (best != -1)
+	{
+		SwapNextDisk = (best + 1) % SwapDiskCount;
+	}
+	return best;
+}
+
+/************************************************************************
+ takeSwap
+ Function used for taking a free slot of a swap disk and recording it
+ in the swap map of a process. A pid of -1 takes a slot for a page of a
+ shared area, which the area records itself.
+ ************************************************************************/
+int takeSwap(int d, int pid, int page) {
+	for (int i = 0; i < SWAP_WORDS; i++)
+	{
+		if (FreeSwap[d][i] != 0)
+		{
+			int slot = d * SWAP_SECTORS + i * 64 + ctz64(FreeSwap[d][i]);
+			FreeSwap[d][i] &= FreeSwap[d][i] - 1;//Clear the lowest set bit
+			SwapDiskFree[d]--;
+			FreeSwapCount--;
+			SwapRefs[slot] = 1;
+			SwapWriting[slot] = 1;//Nothing is in it until it is written
+			if (pid != -1)
+			{
+				SwapMap[pid][page] = slot;
+			}
+			if (SwapDisk(slot) == 1)
+			{
+				for (int s = 0; s < SWAP_PAGE_SECTORS; s++)
+				{
+					writeBitMap(SwapSector(slot) + s, 1);//Keep the file system of disk 1 away from it
+				}
+			}
+			return slot;
+		}
+	}
+	return -1;
+}
+
+/************************************************************************
+ SwapSlotForWrite
+ Function used before writing a modified page out.
+ A page without a slot, or whose slot is held by other processes too,
+ gets one on the least busy swap disk. A page whose
+ old slot is on a disk busier than another swap disk is moved there, so
+ the writes go to the least busy disk.
+ return the slot to write, -1 if no swap slot is left; the page keeps
+ its old slot then.
+ ************************************************************************/
+int SwapSlotForWrite(int pid, int page, int place) {
+	if (place != -1 && SwapRefs[place] > 1)
+	{
+		//The slot still holds the page of another process after a fork
+		int slot = findFreeSwap(pid, page);
+		if (slot != -1)
+		{
+			releaseSwap(place);
+		}
+		return slot;
+	}
+	if (place == -1)
+	{
+		return findFreeSwap(pid, page);
+	}
+	if (SwapDiskCount > 1)
+	{
+		int d = LeastBusySwapDisk();
+		if (d != -1 && d != place / SWAP_SECTORS
+			&& DiskPending[SwapDiskIds[d]] < DiskPending[SwapDisk(place)])
+		{
+			releaseSwap(place);
+			place = takeSwap(d, pid, page);
+			SwapMoves++;
+		}
+	}
+	SwapWriting[place] = 1;//The old copy in it is stale
+	return place;
+}
+/************************************************************************
+ ZCompress, ZDecompress
+ Functions used for packing a page for the swap cache.
+ A page is stored as runs of the difference between neighbouring bytes,
+ each run takes a count and the difference. Pages of the tests hold a
+ word of data over the counting pattern the memory starts with, which
+ packs into a few runs.
+ return the packed length, more than ZCACHE_SLOT_BYTES if it doesn't fit.
+ ************************************************************************/
+int ZCompress(char *page, unsigned char *packed) {
+	unsigned char delta[MAX_PGSIZE];
+	unsigned char last = 0;
+	for (int i = 0; i < PGSIZE; i++)
+	{
+		delta[i] = (unsigned char)((unsigned char)page[i] - last);
+		last = (unsigned char)page[i];
+	}
+	int length = 0;
+	int i = 0;
+	while (i < PGSIZE)
+	{
+		int run = 1;
+		while (i + run < PGSIZE && run < 255 && delta[i + run] == delta[i])
+		{
+			run++;
+		}
+		if (length + 2 > ZCACHE_SLOT_BYTES)
+		{
+			return ZCACHE_SLOT_BYTES + 1;
+		}
+		packed[length++] = (unsigned char)run;
+		packed[length++] = delta[i];
+		i += run;
+	}
+	return length;
+}
+
+void ZDecompress(unsigned char *packed, int length, char *page) {
+	unsigned char last = 0;
+	int i = 0;
+	for (int j = 0; j < length; j += 2)
+	{
+		for (int k = 0; k < packed[j]; k++)
+		{
+			last = (unsigned char)(last + packed[j + 1]);
+			page[i++] = (char)last;
+		}
+	}
+}
+
+/************************************************************************
+ ZCachePut
+ Function used for putting a packed page in the swap cache.
+ When the cache is full the oldest entry is given to the new page at once
+ and its old page is written to a swap slot afterwards, so both pages can
+ be found while the write goes on. Entries of terminated processes are
+ taken first and thrown away.
+ return 1 if the page was put in the cache, 0 if no swap slot is left
+ for the old page, which stays in the cache then.
+ ************************************************************************/
+int ZCachePut(int pid, int page, unsigned char *packed, int length) {
+	int e = -1;
+	for (int i = 0; i < ZCacheSize; i++)
+	{
+		if (ZCache[i].pid == -1)
+		{
+			e = i;
+			break;
+		}
+		if (Blocks[ZCache[i].pid].status == 0)
+		{
+			e = i;
+			ZCacheDropped++;
+			break;
+		}
+		if (e == -1 || ZCache[i].stamp < ZCache[e].stamp)
+		{
+			e = i;
+		}
+	}
+	struct ZCacheEntry old = ZCache[e];
+	int place = -1;
+	if (old.pid != -1 && Blocks[old.pid].status != 0)
+	{
+		place = findFreeSwap(old.pid, old.page);//Recorded now, the owner may fault on it before the write ends
+		if (place == -1)
+		{
+			return 0;
+		}
+	}
+	if (old.pid != -1)
+	{
+		ZCacheMap[old.pid][old.page] = -1;
+	}
+	ZCache[e].pid = pid;
+	ZCache[e].page = page;
+	ZCache[e].length = length;
+	ZCache[e].stamp = ZCacheStamp++;
+	memcpy(ZCache[e].data, packed, length);
+	ZCacheMap[pid][page] = (short)e;
+	ZCacheStores++;
+	ZCacheBytesIn += PGSIZE;
+	ZCacheBytesOut += length;
+
+	if (place != -1)
+	{
+		//Push the old page out to disk
+		char oldpage[MAX_PGSIZE];
+		ZDecompress(old.data, old.length, oldpage);
+		SwapWrite(place, (char *)oldpage);
+		PageOuts++;
+		ZCachePushOuts++;
+	}
+	return 1;
+}
+
+/************************************************************************
+ ZCacheAccept
+ Function used when a modified page is chosen as a victim.
+ If the swap cache is on and the page compresses well it is put in the
+ cache instead of being written, its old swap slot isn't valid any more.
+ return 1 if the page went to the cache.
+ ************************************************************************/
+int ZCacheAccept(int pid, int page, char *data) {
+	unsigned char packed[ZCACHE_SLOT_BYTES + 2];
+	if (ZCacheSize == 0)
+	{
+		return 0;
+	}
+	int length = ZCompress(data, packed);
+	if (length > ZCACHE_SLOT_BYTES)
+	{
+		ZCacheRejects++;
+		return 0;
+	}
+	int place = SwapMap[pid][page];
+	if (!ZCachePut(pid, page, packed, length))
+	{
+		return 0;
+	}
+	if (place != -1)
+	{
+		releaseSwap(place);
+		if (SwapMap[pid][page] == place)
+		{
+			SwapMap[pid][page] = -1;
+		}
+	}
+	return 1;
+}
+
+/************************************************************************
+ ZCacheTake
+ Function used for finding a swapped page in the swap cache.
+ The entry is unpacked into data and given back to the cache.
+ return 1 if the page was in the cache.
+ ************************************************************************/
+int ZCacheTake(int pid, int page, char *data) {
+	if (ZCacheSize == 0 || ZCacheMap[pid][page] == -1)
+	{
+		return 0;
+	}
+	int e = ZCacheMap[pid][page];
+	ZDecompress(ZCache[e].data, ZCache[e].length, data);
+	ZCache[e].pid = -1;
+	ZCacheMap[pid][page] = -1;
+	ZCacheHits++;
+	return 1;
+}
+
+/************************************************************************
+ ReadBack
+ Function used for reading back a page stored in disk.
+ The swap sector is kept, so if the page isn't modified before it is
+ chosen again it can be dropped without writing it out.
+ ************************************************************************/
+void ReadBack(int pid, int victim, int DiskStatus) {
+	unsigned char readswapdisk[MAX_PGSIZE];
+	char writeswapmemory[MAX_PGSIZE];
+	int place = SwapMap[pid][DiskStatus];
+
+	if (ZCacheTake(pid, DiskStatus, writeswapmemory))
+	{
+		//No disk read is needed, the page has no copy in swap now
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		Z502WritePhysicalMemory(victim, (char *)writeswapmemory);
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		MemorySwap[victim] = -1;
+		return;
+	}
+
+	SwapRead(place, (char *)readswapdisk);
+	for (int i = 0; i < PGSIZE; i++)
+	{
+		writeswapmemory[i] = (char)readswapdisk[i];
+	}
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	Z502WritePhysicalMemory(victim, (char *)writeswapmemory);
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	MemorySwap[victim] = place;//The sector is still a valid copy of the page
+	PageIns++;
+}
+
+/************************************************************************
+ WriteVictim
+ Function used by a fault when no physical page is free.
+ A victim is written out and given to the logical page of the faulting
+ process. When no page can be taken the process waits, see WaitForFrame,
+ and then takes a page freed meanwhile or tries again.
+ return the physical page, marked busy.
+ ************************************************************************/
+int WriteVictim(int pid, int MemoryStatus) {
+	int victim = TakeVictim(pid, MemoryStatus);
+	while (victim == -1)
+	{
+		WaitForFrame(pid);
+		victim = getFreePhysicalPage();//The pageout daemon or an ending process may have freed one
+		if (victim == -1)
+		{
+			victim = TakeVictim(pid, MemoryStatus);
+			continue;
+		}
+		*PageEntry(pid, MemoryStatus) = (UINT16)PTBL_VALID_BIT + (UINT16)victim;
+		Blocks[pid].Memory[victim] = MemoryStatus;
+		MemoryOwner[victim] = pid;
+		MemoryAddress[victim] = MemoryStatus;
+		MemoryOrder[victim] = clock;
+		MemoryBusy[victim] = 1;
+		MemoryState[victim] = 2;
+		MemoryPrinter(victim);
+		clock++;
+	}
+	return victim;
+}
+
+/************************************************************************
+ TakeVictim
+ Function used by WriteVictim for one try at evicting a page.
+ return the physical page, -1 if every page is busy or no swap slot is
+ left for the page chosen, which stays with its owner then.
+ ************************************************************************/
+int TakeVictim(int pid, int MemoryStatus) {
+
+	long selectstart = ReadClock();
+	int victim = getVictim(pid);
+	FaultPhase[pid][PHASE_SELECT] += ReadClock() - selectstart;
+	if (victim == -1)
+	{
+		return -1;
+	}
+	int owner = MemoryOwner[victim];//The victim may belong to another process
+	int DiskStatus = Blocks[owner].Memory[victim];
+	char readswap[MAX_PGSIZE];
+
+	if (MemoryShared[victim] > 0)
+	{
+		int slot = SwapOutShared(victim);
+		if (slot == -1)
+		{
+			//No swap slot is left for it, it stays with the area
+			MemoryBusy[victim] = 0;
+			return -1;
+		}
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		Z502ReadPhysicalMemory(victim, (char *)readswap);
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		Blocks[pid].Memory[victim] = MemoryStatus;
+		MemoryOwner[victim] = pid;
+		MemoryAddress[victim] = MemoryStatus;
+		*PageEntry(pid, MemoryStatus) = (UINT16)PTBL_VALID_BIT + (UINT16)victim;
+		SwapWrite(slot, readswap);
+		MemoryOrder[victim] = clock;
+		PageOuts++;
+		MemoryState[victim] = 2;
+		MemoryPrinter(victim);
+		clock++;
+		return victim;
+	}
+
+	int freeplace = MemorySwap[victim];
+	UINT16 entry = (UINT16)PageValue(owner, DiskStatus);
+	UINT16 pidentry = (UINT16)PageValue(pid, MemoryStatus);
+	int cow = (MemoryCow[victim] > 0);//Other processes map it too, they all get the slot written
+	int findex;
+	int fmap = findFileMapping(owner, DiskStatus, &findex);//A page of a mapped file goes back to the file
+	//A page read back from swap and not modified since still has a valid copy there
+	int clean = !cow && (freeplace != -1) && !(entry & PTBL_MODIFIED_BIT);
+	MemorySwap[victim] = -1;
+
+	//Give the physical page to the faulting process before waiting for the disk,
+	//so other processes faulting meanwhile see the new owner (getVictim has marked it busy)
+	Blocks[pid].Memory[victim] = MemoryStatus;
+	MemoryOwner[victim] = pid;
+	MemoryAddress[victim] = MemoryStatus;
+
+	PageWriting[owner][DiskStatus] = 1;//Until the page is out, a fault of the owner on it waits
+	*PageEntry(owner, DiskStatus) = (UINT16)(fmap == -1 ? 2 : 0);
+	InvalidateTLB(owner, DiskStatus);
+	*PageEntry(pid, MemoryStatus) = (UINT16)PTBL_VALID_BIT + (UINT16)victim;
+
+	if (fmap != -1)
+	{
+		//Read from the file again on its next fault, so only a changed page is written
+		if ((entry & PTBL_MODIFIED_BIT) || MappedPageFresh(owner, fmap, findex))
+		{
+			READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+				&LockResult);
+			Z502ReadPhysicalMemory(victim, (char *)readswap);
+			READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+				&LockResult);
+			WriteMappedPage(owner, fmap, findex, readswap);
+		}
+		PageWriting[owner][DiskStatus] = 0;
+		MemoryOrder[victim] = clock;
+		MemoryState[victim] = 2;
+		MemoryPrinter(victim);
+		clock++;
+		return victim;
+	}
+
+	if (clean)
+	{
+		//No disk write is needed
+		PageWriting[owner][DiskStatus] = 0;
+		MemoryOrder[victim] = clock;
+		SwapWritesAvoided++;
+		MemoryState[victim] = 2;
+		MemoryPrinter(victim);
+		clock++;
+		return victim;
+	}
+
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	Z502ReadPhysicalMemory(victim, (char *)readswap);
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	if (!cow && ZCacheAccept(owner, DiskStatus, readswap))
+	{
+		//Kept in the swap cache, no disk write is needed
+		PageWriting[owner][DiskStatus] = 0;
+		MemoryOrder[victim] = clock;
+		MemoryState[victim] = 2;
+		MemoryPrinter(victim);
+		clock++;
+		return victim;
+	}
+	int slot;
+	if (cow)
+	{
+		slot = SwapOutCow(owner, DiskStatus, victim);
+	}
+	else
+	{
+		slot = SwapSlotForWrite(owner, DiskStatus, freeplace);//Recorded now, the owner may fault on it before the write ends
+	}
+	if (slot == -1)
+	{
+		//No swap slot is left for it, the page stays with its owner
+		*PageEntry(pid, MemoryStatus) = pidentry;
+		Blocks[owner].Memory[victim] = DiskStatus;
+		MemoryOwner[victim] = owner;
+		MemoryAddress[victim] = DiskStatus;
+		*PageEntry(owner, DiskStatus) = entry;
+		PageWriting[owner][DiskStatus] = 0;
+		MemorySwap[victim] = freeplace;
+		MemoryBusy[victim] = 0;
+		return -1;
+	}
+	/*if (Blocks[pid].swapinit == 0)
+	{
+		initSwap(pid);
+		Blocks[pid].swapinit = 1;
+	}*/
+
+	unsigned char writeswap[MAX_PGSIZE];
+
+	for (int i = 0; i < PGSIZE; i++)
+	{
+		writeswap[i] = (unsigned char)readswap[i];
+	}
+
+
+
+	SwapWrite(slot, (char *)writeswap);
+	PageWriting[owner][DiskStatus] = 0;
+
+	MemoryOrder[victim] = clock;
+	PageOuts++;
+
+	MemoryState[victim] = 2;
+	MemoryPrinter(victim);
+
+	clock++;
+
+	return victim;
+}
+/************************************************************************
+ findFreeSwap
+ Function used for finding a free swap slot for a logical page of a process.
+ The slot is taken from the free bitmap of the least busy swap disk and
+ recorded in the swap map of the process.
+ return -1 if every slot is used and none can be taken back.
+ ************************************************************************/
+int findFreeSwap(int pid, int page) {
+	int d = LeastBusySwapDisk();
+	if (d != -1)
+	{
+		return takeSwap(d, pid, page);
+	}
+	//All the slots are used, take one back from a page which is in memory
+	for (int i = 0; i < NUMBER_PHYSICAL_PAGES; i++)
+	{
+		if (MemorySwap[i] != -1 && !MemoryBusy[i] && SwapRefs[MemorySwap[i]] == 1)
+		{
+			int place = MemorySwap[i];
+			MemorySwap[i] = -1;
+			SwapWriting[place] = 1;
+			SwapMap[MemoryOwner[i]][MemoryAddress[i]] = -1;
+			if (pid != -1)
+			{
+				SwapMap[pid][page] = place;
+			}
+			return place;
+		}
+	}
+	//printf("\nfull!\n");
+	return -1;
+}
+
+
+/************************************************************************
+ PageOut
+ Function used by the pageout daemon for freeing one physical page.
+ The victim is chosen by the CLOCK hand. It is written to swap unless a
+ clean copy is there already, then the page goes back to the free bitmap.
+ return the freed page, -1 if no page can be chosen.
+ ************************************************************************/
+int PageOut() {
+	char readswap[MAX_PGSIZE];
+	unsigned char writeswap[MAX_PGSIZE];
+	int victim = getVictim(-1);
+	if (victim == -1)
+	{
+		return -1;
+	}
+	if (MemoryShared[victim] > 0)
+	{
+		int slot = SwapOutShared(victim);
+		if (slot == -1)
+		{
+			MemoryBusy[victim] = 0;
+			return -1;
+		}
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		Z502ReadPhysicalMemory(victim, (char *)readswap);
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		SwapWrite(slot, readswap);
+		PageOuts++;
+		MemoryBusy[victim] = 0;
+		releasePhysicalPage(victim);
+		PageoutEvictions++;
+		MemoryPrinter(victim);
+		return victim;
+	}
+	int owner = MemoryOwner[victim];
+	int page = MemoryAddress[victim];
+	UINT16 entry = (UINT16)PageValue(owner, page);
+	int place = MemorySwap[victim];
+	int cow = (MemoryCow[victim] > 0);
+	int findex;
+	int fmap = findFileMapping(owner, page, &findex);
+
+	//getVictim has marked the page busy, from now on the owner reads it back from swap,
+	//or from the file for a page of a mapped file
+	PageWriting[owner][page] = 1;
+	*PageEntry(owner, page) = (UINT16)(fmap == -1 ? 2 : 0);
+	InvalidateTLB(owner, page);
+	if (fmap != -1)
+	{
+		if ((entry & PTBL_MODIFIED_BIT) || MappedPageFresh(owner, fmap, findex))
+		{
+			READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+				&LockResult);
+			Z502ReadPhysicalMemory(victim, (char *)readswap);
+			READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+				&LockResult);
+			WriteMappedPage(owner, fmap, findex, readswap);
+		}
+	}
+	else if (cow || place == -1 || (entry & PTBL_MODIFIED_BIT))
+	{
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		Z502ReadPhysicalMemory(victim, (char *)readswap);
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		MemorySwap[victim] = -1;
+		if (!cow && ZCacheAccept(owner, page, readswap))
+		{
+			PageWriting[owner][page] = 0;
+			MemoryBusy[victim] = 0;
+			releasePhysicalPage(victim);
+			PageoutEvictions++;
+			MemoryPrinter(victim);
+			return victim;
+		}
+		int slot = cow ? SwapOutCow(owner, page, victim) : SwapSlotForWrite(owner, page, place);
+		if (slot == -1)
+		{
+			//No swap slot is left for it, the page stays with its owner
+			*PageEntry(owner, page) = entry;
+			PageWriting[owner][page] = 0;
+			MemorySwap[victim] = place;
+			MemoryBusy[victim] = 0;
+			return -1;
+		}
+		for (int i = 0; i < PGSIZE; i++)
+		{
+			writeswap[i] = (unsigned char)readswap[i];
+		}
+		SwapWrite(slot, (char *)writeswap);
+		PageOuts++;
+	}
+	else
+	{
+		SwapWritesAvoided++;
+	}
+	PageWriting[owner][page] = 0;
+	MemorySwap[victim] = -1;//The slot stays with the page, so it isn't released with the physical page
+	MemoryBusy[victim] = 0;
+	releasePhysicalPage(victim);
+	PageoutEvictions++;
+	MemoryPrinter(victim);
+	return victim;
+}
+
+/************************************************************************
+ PrefetchAround
+ Function used after a fault has read back a swapped page.
+ The swapped pages next to it in the same process are handed to the
+ pageout daemon, which reads them in while the process goes on.
+ ************************************************************************/
+void PrefetchAround(int pid, int page) {
+	if (PrefetchWindow == 0 || PageFaults < PrefetchOffUntil || !PageoutEnabled || ReplacePolicy != POLICY_CLOCK)
+	{
+		return;
+	}
+	for (int d = 1; d <= PrefetchWindow; d++)
+	{
+		for (int side = -1; side <= 1; side += 2)
+		{
+			int p = page + side * d;
+			if (p < 0 || p >= NUMBER_VIRTUAL_PAGES || PageValue(pid, p) != 2 || PrefetchCount == PREFETCH_QUEUE)
+			{
+				continue;
+			}
+			int tail = (PrefetchHead + PrefetchCount) % PREFETCH_QUEUE;
+			PrefetchQueue[tail].pid = pid;
+			PrefetchQueue[tail].page = p;
+			PrefetchCount++;
+		}
+	}
+	if (PrefetchCount > 0)
+	{
+		WakePageout();
+	}
+}
+
+/************************************************************************
+ Prefetch
+ Function used by the pageout daemon for reading in a swapped page ahead
+ of a fault. The page table entry stays 2 during the read; if the owner
+ faults the page in meanwhile the prefetched copy is dropped.
+ ************************************************************************/
+void Prefetch(int pid, int page) {
+	unsigned char readswapdisk[MAX_PGSIZE];
+	if (Blocks[pid].status == 0 || PageValue(pid, page) != 2 || SwapMap[pid][page] == -1
+		|| PageWriting[pid][page])
+	{
+		return;//Already brought in by a fault, or not written out yet
+	}
+	int pn = getFreePhysicalPage();
+	if (pn == -1)
+	{
+		return;
+	}
+	int place = SwapMap[pid][page];
+	MemoryOwner[pn] = pid;
+	MemoryAddress[pn] = page;
+	MemoryBusy[pn] = 1;
+	unsigned int version = SwapVersion[place];
+
+	SwapRead(place, (char *)readswapdisk);
+
+	if (Blocks[pid].status == 0 || PageValue(pid, page) != 2 || SwapMap[pid][page] != place
+		|| SwapWriting[place] || SwapVersion[place] != version)
+	{
+		//The owner faulted on it while it was being read, or terminated,
+		//or the page was written out to the slot again meanwhile
+		MemoryBusy[pn] = 0;
+		releasePhysicalPage(pn);
+		PrefetchDropped++;
+		return;
+	}
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	Z502WritePhysicalMemory(pn, (char *)readswapdisk);
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	Blocks[pid].Memory[pn] = page;
+	MemoryOrder[pn] = clock;
+	MemoryState[pn] = 2;
+	MemorySwap[pn] = place;//Clean copy, it can be dropped without a write
+	MemoryPrefetched[pn] = 1;
+	MemoryBusy[pn] = 0;
+	*PageEntry(pid, page) = (UINT16)PTBL_VALID_BIT + (UINT16)pn;
+	PrefetchReads++;
+	clock++;
+	MemoryPrinter(pn);
+}
+
+/************************************************************************
+ PageoutDaemon
+ Code of the pageout daemon.
+ It runs in kernel mode like the fault handler. Each time it is woken it
+ frees pages until PAGEOUT_HIGH pages are free, then reads in the pages
+ asked for by PrefetchAround, then waits again, so most page faults find
+ a free page and need at most one disk read.
+ ************************************************************************/
+void PageoutDaemon() {
+	while (1)
+	{
+		while (FreeFrameCount < PAGEOUT_HIGH)
+		{
+			if (PageOut() == -1)
+			{
+				break;
+			}
+		}
+		//Prefetch only uses pages above the reserve
+		while (PrefetchCount > 0 && FreeFrameCount > PAGEOUT_LOW)
+		{
+			struct PrefetchRequest pr = PrefetchQueue[PrefetchHead];
+			PrefetchHead = (PrefetchHead + 1) % PREFETCH_QUEUE;
+			PrefetchCount--;
+			Prefetch(pr.pid, pr.page);
+		}
+		Blocks[PageoutPID].state = STATE_PAGEOUT_WAIT;
+		Blocks[PageoutPID].queue = QUEUE_NONE;
+		dispatcher();
+	}
+}
+
+/************************************************************************
+ WakePageout
+ Function used for waking the pageout daemon when free pages run low.
+ The daemon is started the first time it is needed, so it takes no PCB
+ in the tests which never fill the memory.
+ ************************************************************************/
+void WakePageout() {
+	MEMORY_MAPPED_IO mmio;
+	if (!PageoutEnabled || ReplacePolicy != POLICY_CLOCK)
+	{
+		return;
+	}
+	if (PageoutPID == -1)
+	{
+		if (PID == 14)
+		{
+			//No PCB left, the faults keep on evicting by themselves
+			PageoutEnabled = 0;
+			return;
+		}
+		short **PageTable = NewPageTable();
+		mmio.Mode = Z502InitializeContext;
+		mmio.Field1 = 0;
+		mmio.Field2 = (long)PageoutDaemon;
+		mmio.Field3 = (long)PageTable;
+		MEM_WRITE(Z502Context, &mmio);
+
+		struct PCB P;
+		P.pid = PID;
+		P.Context = mmio.Field1;
+		P.status = 1;
+		strcpy(P.name, "Pageout");
+		P.order = PAGEOUT_PRIORITY;
+		P.weight = PriorityToWeight(P.order);
+		P.vruntime = MinVruntime;
+		P.dtime = 0;
+		P.cputime = 0;
+		P.state = STATE_READY;
+		P.queue = QUEUE_NONE;
+		P.PageTable = PageTable;
+		P.quota = 0;
+		P.lastfault = 0;
+		P.memsuspend = 0;
+		P.leaves = 0;
+		Blocks[PID] = P;
+		Timestamp(PID, EVENT_CREATE);
+		PageoutPID = PID;
+		PID++;
+		MakeReady(PageoutPID);
+		CallSchedulePrinter(0, Blocks[PageoutPID].pid);
+	}
+	else if (Blocks[PageoutPID].state == STATE_PAGEOUT_WAIT)
+	{
+		MakeReady(PageoutPID);
+	}
+}
+
+/************************************************************************
+ WaitForFrame
+ Function used when a fault finds no page it can evict: every page is
+ busy being written out or read in, or no swap slot is left for the
+ page chosen. The pageout daemon is woken and the process sleeps for
+ FRAME_WAIT before it looks again.
+ ************************************************************************/
+void WaitForFrame(int pid) {
+	FrameWaits++;
+	FrameWaiters++;
+	WakePageout();
+	SleepFor(pid, FRAME_WAIT);
+	FrameWaiters--;
+}
+
+/************************************************************************
+ WaitForWrite
+ Function used when a process needs a page which is being written out,
+ or reads a swap slot before the write to it has ended. The copy on the
+ disk isn't there yet, so the process sleeps for WRITE_WAIT and looks
+ again.
+ ************************************************************************/
+void WaitForWrite(int pid) {
+	WriteWaits++;
+	SleepFor(pid, WRITE_WAIT);
+}
+
+/************************************************************************
+ SleepFor
+ Function used for putting a process on the timer queue from the
+ kernel, as SLEEP does, and running another one meanwhile.
+ ************************************************************************/
+void SleepFor(int pid, int ticks) {
+	MEMORY_MAPPED_IO mmio;
+	int wakeup = (int)ReadClock() + ticks;
+	Blocks[pid].ptime = wakeup;
+	Blocks[pid].state = STATE_TIMER_WAIT;
+	Blocks[pid].queue = QUEUE_TIMER;
+	InsertTimerOrder(&Blocks[pid], wakeup);
+	if (TimerReadPID(0) == pid)
+	{
+		//It wakes up first, start the timer for it
+		mmio.Mode = Z502Start;
+		mmio.Field1 = ticks;
+		mmio.Field2 = mmio.Field3 = 0;
+		MEM_WRITE(Z502Timer, &mmio);
+	}
+	dispatcher();
+}
+
+/************************************************************************
+ ForkMemory
+ Function used by FORK_PROCESS for giving the new process the pages of
+ its parent. A page in memory is mapped by both, read only, and copied
+ by the first one writing it (see BreakCow); a swapped page shares its
+ swap slot. A page in the swap cache is written to a swap slot of the
+ child, see ForkSwapFits. Shared areas stay shared, the child faults
+ their pages in.
+ ************************************************************************/
+void ForkMemory(int parent, int child) {
+	unsigned char packed[ZCACHE_MAX][ZCACHE_SLOT_BYTES];
+	int lengths[ZCACHE_MAX];
+	int slots[ZCACHE_MAX];
+	int copies = 0;
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 10, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Lock
+	for (int i = 0; i < MAX_SHARED_AREAS; i++)
+	{
+		SharedMappings[child][i] = SharedMappings[parent][i];
+		if (SharedMappings[child][i].area != -1)
+		{
+			AddAreaMapper(SharedMappings[child][i].area);
+		}
+	}
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 10, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Unlock
+	for (int j = 0; j < NUMBER_VIRTUAL_PAGES; j++)
+	{
+		while (PageWriting[parent][j])
+		{
+			WaitForWrite(parent);//The child shares the slot, which isn't chosen yet
+		}
+	}
+	for (int j = 0; j < NUMBER_VIRTUAL_PAGES; j++)
+	{
+		int index;
+		UINT16 entry = (UINT16)PageValue(parent, j);
+		if (entry == 0 || findSharedArea(parent, j, &index) != -1
+			|| findFileMapping(parent, j, &index) != -1)
+		{
+			continue;//Files mapped by the parent are not mapped in the child
+		}
+		if (SwapMap[parent][j] != -1)
+		{
+			SwapMap[child][j] = SwapMap[parent][j];
+			SwapRefs[SwapMap[child][j]]++;
+		}
+		if (entry & PTBL_VALID_BIT)
+		{
+			int frame = entry & PTBL_PHYS_PG_NO;
+			entry |= PTBL_READ_ONLY_BIT;
+			*PageEntry(parent, j) = entry;
+			MemoryCow[frame] = (MemoryCow[frame] == 0 ? 1 : MemoryCow[frame]) + 1;
+		}
+		else if (ZCacheMap[parent][j] != -1)
+		{
+			//Copied before the first write waits, the parent's entry may be pushed out meanwhile
+			struct ZCacheEntry *ze = &ZCache[ZCacheMap[parent][j]];
+			lengths[copies] = ze->length;
+			memcpy(packed[copies], ze->data, ze->length);
+			slots[copies] = findFreeSwap(child, j);
+			copies++;
+		}
+		*PageEntry(child, j) = entry;
+		CowShared++;
+	}
+	InvalidateTLB(parent, -1);//Its pages are read only now
+	for (int i = 0; i < copies; i++)
+	{
+		char data[MAX_PGSIZE];
+		ZDecompress(packed[i], lengths[i], data);
+		SwapWrite(slots[i], data);
+		PageOuts++;
+	}
+	CowForks++;
+}
+
+/************************************************************************
+ ForkSwapFits
+ Function used before FORK_PROCESS for checking that the swap has a slot
+ for each page of the parent in the swap cache.
+ return 1 if the child's copies of them fit.
+ ************************************************************************/
+int ForkSwapFits(int parent) {
+	int needed = 0;
+	int left = FreeSwapCount;
+	for (int i = 0; i < ZCacheSize; i++)
+	{
+		if (ZCache[i].pid == parent)
+		{
+			needed++;
+		}
+	}
+	for (int i = 0; i < NUMBER_PHYSICAL_PAGES; i++)
+	{
+		if (MemorySwap[i] != -1 && !MemoryBusy[i] && SwapRefs[MemorySwap[i]] == 1)
+		{
+			left++;//findFreeSwap can take it back
+		}
+	}
+	return needed <= left;
+}
+
+/************************************************************************
+ BreakCow
+ Function used by the fault handler for a write to a page shared
+ copy-on-write. The writer gets a copy of its own; when no other
+ process maps the page any more it only needs to be made writable.
+ ************************************************************************/
+void BreakCow(int pid, int page) {
+	char data[MAX_PGSIZE];
+	UINT16 entry = (UINT16)PageValue(pid, page);
+	int frame = entry & PTBL_PHYS_PG_NO;
+	if (!(entry & PTBL_READ_ONLY_BIT))
+	{
+		return;
+	}
+	if (MemoryCow[frame] == 0)
+	{
+		*PageEntry(pid, page) = entry & ~PTBL_READ_ONLY_BIT;
+		InvalidateTLB(pid, page);
+		CowReuses++;
+		return;
+	}
+
+	//Keep the page from being chosen while it is copied
+	LockFrame(frame);
+	MemoryBusy[frame] = 1;
+	UnlockFrame(frame);
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	Z502ReadPhysicalMemory(frame, data);
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+
+	int pn = getFreePhysicalPage();
+	if (pn == -1)
+	{
+		FaultEvictions++;
+		pn = WriteVictim(pid, page);//Maps the victim for the page
+	}
+	else
+	{
+		*PageEntry(pid, page) = (UINT16)PTBL_VALID_BIT + (UINT16)pn;
+		Blocks[pid].Memory[pn] = page;
+		MemoryOwner[pn] = pid;
+		MemoryAddress[pn] = page;
+		MemoryOrder[pn] = clock;
+		clock++;
+	}
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	Z502WritePhysicalMemory(pn, data);
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	MemoryState[pn] = 1;
+	MemoryBusy[pn] = 0;
+	if (SwapMap[pid][page] != -1)
+	{
+		//The copy is modified, the slot shared with the others isn't its copy
+		if (MemoryOwner[frame] == pid)
+		{
+			MemorySwap[frame] = -1;//It was the copy of the owner
+		}
+		releaseSwap(SwapMap[pid][page]);
+		SwapMap[pid][page] = -1;
+	}
+	MemoryBusy[frame] = 0;
+	DropCowRef(frame, pid);
+	InvalidateTLB(pid, page);
+	CowCopies++;
+	MemoryPrinter(pn);
+}
+
+/************************************************************************
+ DropCowRef
+ Function used after a process stops mapping a page shared copy-on-write.
+ When it owned the page, another process mapping it becomes the owner,
+ and its swap slot the copy of the page. A page only one process maps
+ is its own again; a page nobody maps is freed.
+ ************************************************************************/
+void DropCowRef(int frame, int pid) {
+	int page = MemoryAddress[frame];
+	int mapper = -1;
+	int count = 0;
+	for (int q = 0; q < PID; q++)
+	{
+		UINT16 entry = (UINT16)PageValue(q, page);
+		if (q == pid || Blocks[q].status == 0 || !(entry & PTBL_VALID_BIT)
+			|| (entry & PTBL_PHYS_PG_NO) != frame)
+		{
+			continue;
+		}
+		count++;
+		if (mapper == -1 || q == MemoryOwner[frame])
+		{
+			mapper = q;
+		}
+	}
+	if (count == 0)
+	{
+		MemoryCow[frame] = 0;
+		if (!MemoryBusy[frame])
+		{
+			releasePhysicalPage(frame);
+		}
+		return;
+	}
+	if (MemoryOwner[frame] != mapper)
+	{
+		MemoryOwner[frame] = mapper;
+		Blocks[mapper].Memory[frame] = page;
+		MemorySwap[frame] = SwapMap[mapper][page];
+	}
+	MemoryCow[frame] = (count > 1) ? count : 0;
+}
+
+/************************************************************************
+ SwapOutCow
+ Function used when a page shared copy-on-write is chosen as a victim.
+ Every process mapping it reads it back from the same new swap slot,
+ its old slots are given back.
+ return the slot to write, -1 if no swap slot is left; nothing is
+ changed then.
+ ************************************************************************/
+int SwapOutCow(int owner, int page, int frame) {
+	int mappers[14];
+	int count = 0;
+	int slot = findFreeSwap(-1, page);
+	if (slot == -1)
+	{
+		return -1;
+	}
+	for (int q = 0; q < PID; q++)
+	{
+		UINT16 entry = (UINT16)PageValue(q, page);
+		if (q == owner || Blocks[q].status == 0 || !(entry & PTBL_VALID_BIT)
+			|| (entry & PTBL_PHYS_PG_NO) != frame)
+		{
+			continue;
+		}
+		*PageEntry(q, page) = (UINT16)2;
+		InvalidateTLB(q, page);
+		if (SwapMap[q][page] != -1)
+		{
+			releaseSwap(SwapMap[q][page]);
+			SwapMap[q][page] = -1;
+		}
+		mappers[count++] = q;
+	}
+	if (SwapMap[owner][page] != -1)
+	{
+		releaseSwap(SwapMap[owner][page]);
+	}
+	SwapMap[owner][page] = slot;
+	for (int i = 0; i < count; i++)
+	{
+		int q = mappers[i];
+		SwapMap[q][page] = slot;
+		SwapRefs[slot]++;
+	}
+	MemoryCow[frame] = 0;
+	return slot;
+}
+
+/************************************************************************
+ FreeProcessMemory
+ Function used when a process is terminated for giving back everything
+ its memory holds: its mapped files, its pages of shared areas, its
+ pages shared copy-on-write, its physical pages, its
+ swap slots and swap cache entries, then its page table and its name.
+ A page which is busy is being written out or read in for the process,
+ the fault or the pageout daemon doing it frees it when it is done.
+ ************************************************************************/
+void FreeProcessMemory(int pid) {
+	UnmapFiles(pid);//Their changed pages are written back first
+	InvalidateTLB(pid, -1);
+
+	//Pages of shared areas, in memory or in swap, are given back when no other process maps them
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 10, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Lock
+	for (int i = 0; i < MAX_SHARED_AREAS; i++)
+	{
+		struct SharedMapping *sm = &SharedMappings[pid][i];
+		if (sm->area == -1)
+		{
+			continue;
+		}
+		struct SharedArea *sa = &SharedAreas[sm->area];
+		sa->mappers--;
+		for (int j = 0; j < sa->pages; j++)
+		{
+			int frame = sa->frames[j];
+			if (frame != -1 && --MemoryShared[frame] == 0)
+			{
+				sa->frames[j] = -1;
+				sa->changes[j]++;
+				releasePhysicalPage(frame);
+				ReclaimedFrames++;
+			}
+			if (sa->mappers == 0 && sa->slots[j] != -1)
+			{
+				releaseSwap(sa->slots[j]);
+				sa->slots[j] = -1;
+				sa->changes[j]++;
+				ReclaimedSwapSlots++;
+			}
+		}
+		sm->area = -1;
+	}
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 10, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Unlock
+
+	//Pages shared copy-on-write stay with the other processes mapping them
+	for (int j = 0; j < NUMBER_VIRTUAL_PAGES; j++)
+	{
+		UINT16 entry = (UINT16)PageValue(pid, j);
+		int frame = entry & PTBL_PHYS_PG_NO;
+		if ((entry & PTBL_VALID_BIT) && MemoryCow[frame] > 0)
+		{
+			*PageEntry(pid, j) = 0;
+			DropCowRef(frame, pid);
+		}
+	}
+
+	for (int i = 0; i < NUMBER_PHYSICAL_PAGES; i++)
+	{
+		if (MemoryOwner[i] == pid && MemoryShared[i] == 0 && ClaimFrame(i))
+		{
+			if (MemorySwap[i] != -1)
+			{
+				ReclaimedSwapSlots++;//Given back with the page
+			}
+			if (MemoryPrefetched[i])
+			{
+				JudgePrefetch(i, 0);//Never used
+			}
+			MemoryBusy[i] = 0;
+			releasePhysicalPage(i);
+			ReclaimedFrames++;
+		}
+	}
+
+	for (int j = 0; j < NUMBER_VIRTUAL_PAGES; j++)
+	{
+		if (SwapMap[pid][j] != -1)
+		{
+			releaseSwap(SwapMap[pid][j]);
+			SwapMap[pid][j] = -1;
+			ReclaimedSwapSlots++;
+		}
+		if (ZCacheMap[pid][j] != -1)
+		{
+			ZCache[ZCacheMap[pid][j]].pid = -1;
+			ZCacheMap[pid][j] = -1;
+			ZCacheDropped++;
+		}
+	}
+
+	//The context keeps pointing at the page table, but it never runs again
+	for (int i = 0; i < PTBL_DIRECTORY_ENTRIES; i++)
+	{
+		free(Blocks[pid].PageTable[i]);
+	}
+	free(Blocks[pid].PageTable);
+	Blocks[pid].PageTable = NULL;
+	ReclaimedLeaves += Blocks[pid].leaves;
+	Blocks[pid].leaves = 0;
+	ProcessesReclaimed++;
+}
+
+/************************************************************************
+ dispatcher
+ Function used for running the processes in ready queue.
+ ************************************************************************/
+void dispatcher() {
+
+	MEMORY_MAPPED_IO    mmio;      // Enables communication with hardware
+	ChargeRunningTime();//Charge the process giving up the CPU
+	if (ReadyEmpty())
+	{
+		IdleMemory();//Only an interrupt can make a process ready after this
+	}
+	while (ReadyEmpty()) {
+		//When ready queue is empty, keep on waiting.
+		CALL(WasteTime());
+	}
+
+	
+	int retpid=ReadyReadPID(0);//Get the pid of the head of ready queue
+	//char *nm = ReadyReadName(0);
+
+
+
+	//printf("return PID: %d\n", retpid);
+	//printf("return Name: %s\n", nm);
+
+
+	RemoveReadyItem(&Blocks[retpid]);//Remove the head item from ready queue
+
+	//The head has the smallest virtual runtime
+	if (Blocks[retpid].vruntime > MinVruntime)
+	{
+		MinVruntime = Blocks[retpid].vruntime;
+	}
+	mmio.Mode = Z502ReturnValue;
+	mmio.Field1 = mmio.Field2 = mmio.Field3 = mmio.Field4 = 0;
+	MEM_READ(Z502Clock, &mmio);
+	Blocks[retpid].dtime = (int)mmio.Field1;//Start charging from now
+	Timestamp(retpid, EVENT_DISPATCH);
+	Blocks[retpid].state = STATE_RUNNING;
+	Blocks[retpid].queue = QUEUE_NONE;
+
+
+	CallSchedulePrinter(2,Blocks[retpid].pid);//Call the schedule printer for printing the status
+
+	//Start the corresponding process
+	mmio.Mode = Z502StartContext;
+	mmio.Field1 = Blocks[retpid].Context;
+	mmio.Field2 = START_NEW_CONTEXT_AND_SUSPEND;
+	mmio.Field3 = mmio.Field4 = 0;
+	MEM_WRITE(Z502Context, &mmio);
+	
+
+}
+
+/************************************************************************
+ PriorityToWeight
+ Function used for mapping a priority to the weight of a process.
+ A smaller priority number gets a larger weight (a larger share of the CPU).
+ Priority 10 has a weight of NICE_0_WEIGHT, and every PRIORITY_PER_STEP
+ changes the weight by 25%, like the nice levels of Linux.
+ ************************************************************************/
+int PriorityToWeight(long order) {
+	double nice = (double)(order - 10) / PRIORITY_PER_STEP;
+	int weight = (int)(NICE_0_WEIGHT / pow(1.25, nice));
+	if (weight < 1)
+	{
+		weight = 1;
+	}
+	return weight;
+}
+
+/************************************************************************
+ ChargeRunningTime
+ Function used for charging the CPU time of the current running process.
+ The time since its last dispatch is added to its CPU time, and its
+ virtual runtime grows by that time scaled by NICE_0_WEIGHT / weight.
+ ************************************************************************/
+void ChargeRunningTime() {
+	MEMORY_MAPPED_IO    mmio;      // Enables communication with hardware
+
+	//Get the current time
+	mmio.Mode = Z502ReturnValue;
+	mmio.Field1 = mmio.Field2 = mmio.Field3 = mmio.Field4 = 0;
+	MEM_READ(Z502Clock, &mmio);
+	int nowtime = (int)mmio.Field1;
+
+	//Get the current context
+	mmio.Mode = Z502GetCurrentContext;
+	mmio.Field1 = mmio.Field2 = mmio.Field3 = mmio.Field4 = 0;
+	MEM_READ(Z502Context, &mmio);
+
+	//Find the current running process
+	for (int g = 0; g < PID; g++)
+	{
+		if (Blocks[g].Context == mmio.Field1)
+		{
+			int used = nowtime - Blocks[g].dtime;
+			if (used > 0)
+			{
+				Blocks[g].cputime += used;
+				Blocks[g].vruntime += (long)used * NICE_0_WEIGHT / Blocks[g].weight;
+			}
+			Blocks[g].dtime = nowtime;
+			break;
+		}
+	}
+}
+
+/************************************************************************
+ MakeReady
+ Function used for putting a process on the ready queue.
+ A suspended process which has finished waiting is left on the suspend
+ queue instead.
+ The ready queue is ordered by virtual runtime. A process which has been
+ waiting keeps at most SLEEPER_CREDIT of virtual runtime below the others,
+ so it can't take the CPU for a long time after waking up.
+ ************************************************************************/
+void MakeReady(int pid) {
+	if (Blocks[pid].state == STATE_SUSPENDED)
+	{
+		//It was suspended while waiting, it stays on the suspend queue until resumed
+		Blocks[pid].queue = QUEUE_SUSPEND;
+		return;
+	}
+	Blocks[pid].state = STATE_READY;
+	Blocks[pid].queue = QUEUE_READY;
+	if (Blocks[pid].vruntime < MinVruntime - SLEEPER_CREDIT)
+	{
+		Blocks[pid].vruntime = MinVruntime - SLEEPER_CREDIT;
+	}
+	Timestamp(pid, EVENT_READY);
+	InsertReadyOrder(&Blocks[pid], (int)Blocks[pid].vruntime);//Insert with virtual runtime as the order
+}
+
+/************************************************************************
+ LeaveQueue
+ Function used for taking a process off the queue it is on.
+ The queue field of the PCB tells which queue to use, so no scan of
+ the other queues is needed.  The PCB also keeps the node holding it on
+ that queue (and on the suspend queue), so it is unlinked without a walk.
+ ************************************************************************/
+void LeaveQueue(int pid) {
+	if (Blocks[pid].state == STATE_SUSPENDED)
+	{
+		RemoveSuspendItem(&Blocks[pid]);
+	}
+	switch (Blocks[pid].queue) {
+	case QUEUE_READY:
+		RemoveReadyItem(&Blocks[pid]);
+		break;
+	case QUEUE_TIMER:
+		RemoveTimerItem(&Blocks[pid]);
+		break;
+	case QUEUE_DISK:
+		RemoveDiskItem(&Blocks[pid]);
+		break;
+	case QUEUE_MESSAGE:
+		RemoveMessageItem(&Blocks[pid]);
+		break;
+	}
+	Blocks[pid].queue = QUEUE_NONE;
+}
+
+/************************************************************************
+ getCurrentPID
+ Function used for getting the PCB index of the current running process.
+ return -1 if it can't be found.
+ ************************************************************************/
+int getCurrentPID() {
+	MEMORY_MAPPED_IO    mmio;      // Enables communication with hardware
+
+	//Get the current context
+	mmio.Mode = Z502GetCurrentContext;
+	mmio.Field1 = mmio.Field2 = mmio.Field3 = mmio.Field4 = 0;
+	MEM_READ(Z502Context, &mmio);
+
+	for (int i = 0; i < PID; i++)
+	{
+		if (Blocks[i].Context == mmio.Field1)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+/************************************************************************
+ initMessages
+ Function used for putting all the message buffers on the free list
+ and emptying all the mailboxes.
+ ************************************************************************/
+void initMessages() {
+	FreeMessages = NULL;
+	for (int i = MESSAGE_POOL_SIZE - 1; i >= 0; i--)
+	{
+		MessagePool[i].next = FreeMessages;
+		FreeMessages = &MessagePool[i];
+	}
+	for (int i = 0; i < 14; i++)
+	{
+		Mailboxes[i].head = Mailboxes[i].tail = NULL;
+		Mailboxes[i].count = 0;
+	}
+	BroadcastBox.head = BroadcastBox.tail = NULL;
+	BroadcastBox.count = 0;
+}
+
+/************************************************************************
+ TakeMessage
+ Function used for finding the first message in a mailbox which is from
+ a specific sender (-1 means anyone), and isn't sent by the receiver.
+ If remove is 1, the message is also taken out of the mailbox.
+ return NULL if there is no such message.
+ The caller must hold the message lock.
+ ************************************************************************/
+struct Message *TakeMessage(struct Mailbox *box, int source, int receiver, int remove) {
+	struct Message *prev = NULL;
+	struct Message *m = box->head;
+	while (m != NULL)
+	{
+		if ((source == -1 || m->source == source) && m->source != receiver)
+		{
+			if (remove)
+			{
+				if (prev == NULL)
+					box->head = m->next;
+				else
+					prev->next = m->next;
+				if (box->tail == m)
+					box->tail = prev;
+				box->count--;
+			}
+			return m;
+		}
+		prev = m;
+		m = m->next;
+	}
+	return NULL;
+}
+
+/************************************************************************
+ FreeMailbox
+ Function used for giving the messages of a terminated process back
+ to the free list.
+ ************************************************************************/
+void FreeMailbox(int pid) {
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 9, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Lock
+	struct Message *m = Mailboxes[pid].head;
+	while (m != NULL)
+	{
+		struct Message *next = m->next;
+		m->next = FreeMessages;
+		FreeMessages = m;
+		m = next;
+	}
+	Mailboxes[pid].head = Mailboxes[pid].tail = NULL;
+	Mailboxes[pid].count = 0;
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 9, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Unlock
+}
+
+/************************************************************************
+ WakeReceiver
+ Function used for waking up a process waiting for a message from the
+ sender.  A suspended one is taken off the message queue but stays
+ suspended.
+ The caller must hold the message lock.
+ ************************************************************************/
+void WakeReceiver(int pid, int sender) {
+	if (Blocks[pid].queue == QUEUE_MESSAGE
+		&& (Blocks[pid].msgsource == -1 || Blocks[pid].msgsource == sender))
+	{
+		RemoveMessageItem(&Blocks[pid]);
+		Blocks[pid].queue = QUEUE_NONE;
+		MakeReady(pid);
+	}
+}
+
+/************************************************************************
+ SendMessage
+ Function used for doing the SEND_MESSAGE system call.
+ Argument[0] is the target PID (-1 means broadcast), Argument[1] is the
+ message, Argument[2] is its length and Argument[3] returns the error.
+ The message is copied into a buffer from the pool and put in the
+ mailbox of the target.  A full mailbox is an error, the sender doesn't
+ wait.
+ ************************************************************************/
+void SendMessage(SYSTEM_CALL_DATA *SystemCallData) {
+	int target = (int)(long)SystemCallData->Argument[0];
+	int length = (int)(long)SystemCallData->Argument[2];
+	int sender = getCurrentPID();
+
+	if (target < -1 || target >= PID || (target >= 0 && Blocks[target].state == STATE_TERMINATED))
+	{
+		//Invalid target
+		*(long *)SystemCallData->Argument[3] = ERR_BAD_PARAM;
+		return;
+	}
+	if (length < 0 || length > MAX_MESSAGE_LENGTH)
+	{
+		//Invalid length
+		*(long *)SystemCallData->Argument[3] = ERR_BAD_PARAM;
+		return;
+	}
+
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 9, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Lock
+	struct Mailbox *box = (target == -1) ? &BroadcastBox : &Mailboxes[target];
+	if (box->count >= MAILBOX_SIZE || FreeMessages == NULL)
+	{
+		//No space for this message
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 9, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);//Unlock
+		*(long *)SystemCallData->Argument[3] = ERR_BAD_PARAM;
+		return;
+	}
+
+	//Take a buffer from the pool and fill it
+	struct Message *m = FreeMessages;
+	FreeMessages = m->next;
+	m->source = sender;
+	m->target = target;
+	m->length = length;
+	memcpy(m->buffer, (char *)SystemCallData->Argument[1], length);
+	m->next = NULL;
+
+	//Put it at the tail of the mailbox
+	if (box->tail == NULL)
+		box->head = m;
+	else
+		box->tail->next = m;
+	box->tail = m;
+	box->count++;
+	MessagesSent++;
+
+	//Wake up the receiver if it is waiting for this message
+	if (target != -1)
+	{
+		WakeReceiver(target, sender);
+	}
+	else
+	{
+		//Wake up the first process waiting for a message from us
+		int waitpid;
+		for (int i = 0; (waitpid = MessageReadPID(i)) != -1; i++)
+		{
+			if (waitpid != sender && (Blocks[waitpid].msgsource == -1 || Blocks[waitpid].msgsource == sender))
+			{
+				WakeReceiver(waitpid, sender);
+				break;
+			}
+		}
+	}
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 9, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Unlock
+
+	CallSchedulePrinter(6, Blocks[sender].pid);//Call the schedule printer
+	*(long *)SystemCallData->Argument[3] = ERR_SUCCESS;
+}
+
+/************************************************************************
+ ReceiveMessage
+ Function used for doing the RECEIVE_MESSAGE system call.
+ Argument[0] is the source PID (-1 means anyone), Argument[1] is the
+ buffer, Argument[2] is the size of the buffer, Argument[3] returns the
+ length of the message, Argument[4] returns the sender and Argument[5]
+ returns the error.
+ When there is no message yet, the process waits on the message queue
+ until a sender wakes it up.
+ ************************************************************************/
+void ReceiveMessage(SYSTEM_CALL_DATA *SystemCallData) {
+	int source = (int)(long)SystemCallData->Argument[0];
+	int maxlength = (int)(long)SystemCallData->Argument[2];
+	int receiver = getCurrentPID();
+
+	if (source < -1 || source >= PID || maxlength < 0 || maxlength > MAX_MESSAGE_LENGTH)
+	{
+		//Invalid source or length
+		*(long *)SystemCallData->Argument[5] = ERR_BAD_PARAM;
+		return;
+	}
+
+	while (1)
+	{
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 9, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);//Lock
+		struct Mailbox *box = &Mailboxes[receiver];
+		struct Message *m = TakeMessage(box, source, receiver, 0);
+		if (m == NULL)
+		{
+			box = &BroadcastBox;
+			m = TakeMessage(box, source, receiver, 0);
+		}
+		if (m != NULL)
+		{
+			if (m->length > maxlength)
+			{
+				//The buffer is too small, leave the message in the mailbox
+				READ_MODIFY(MEMORY_INTERLOCK_BASE + 9, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+					&LockResult);//Unlock
+				*(long *)SystemCallData->Argument[5] = ERR_BAD_PARAM;
+				return;
+			}
+			TakeMessage(box, source, receiver, 1);
+			memcpy((char *)SystemCallData->Argument[1], m->buffer, m->length);
+			*(long *)SystemCallData->Argument[3] = m->length;
+			*(long *)SystemCallData->Argument[4] = m->source;
+			m->next = FreeMessages;//Give the buffer back to the pool
+			FreeMessages = m;
+			MessagesReceived++;
+			READ_MODIFY(MEMORY_INTERLOCK_BASE + 9, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+				&LockResult);//Unlock
+			*(long *)SystemCallData->Argument[5] = ERR_SUCCESS;
+			return;
+		}
+
+		//No message yet, wait on the message queue
+		Blocks[receiver].msgsource = source;
+		Blocks[receiver].state = STATE_MSG_WAIT;
+		Blocks[receiver].queue = QUEUE_MESSAGE;
+		InsertMessageTail(&Blocks[receiver]);
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 9, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);//Unlock
+
+		CallSchedulePrinter(7, Blocks[receiver].pid);//Call the schedule printer
+		dispatcher();//Run another process until a message comes
+	}
+}
+
+/************************************************************************
+ findSharedArea
+ Function used for checking whether a logical page of a process is in
+ one of the shared areas it has defined.
+ return the index of the area and put the page number inside the area
+ into *index, or return -1 if it is a private page.
+ ************************************************************************/
+int findSharedArea(int pid, int page, int *index) {
+	for (int i = 0; i < MAX_SHARED_AREAS; i++)
+	{
+		struct SharedMapping *sm = &SharedMappings[pid][i];
+		if (sm->area != -1 && page >= sm->start && page < sm->start + SharedAreas[sm->area].pages)
+		{
+			*index = page - sm->start;
+			return sm->area;
+		}
+	}
+	return -1;
+}
+
+/************************************************************************
+ DefineSharedArea
+ Function used for doing the DEFINE_SHARED_AREA system call.
+ Argument[0] is the starting logical address, Argument[1] is the number
+ of pages, Argument[2] is the tag, Argument[3] returns the shared ID and
+ Argument[4] returns the error.
+ Every process using the same tag gets the same physical pages.  The
+ pages are brought in by the fault handler on first use, and the shared
+ ID is the number of processes which defined the area before. The area
+ keeps its pages while any process maps it.
+ ************************************************************************/
+void DefineSharedArea(SYSTEM_CALL_DATA *SystemCallData) {
+	long start = (long)SystemCallData->Argument[0];
+	int pages = (int)(long)SystemCallData->Argument[1];
+	char *tag = (char *)SystemCallData->Argument[2];
+	int pid = getCurrentPID();
+	int i;
+
+	if (start < 0 || start % PGSIZE != 0 || pages <= 0 || pages > MAX_SHARED_PAGES
+		|| start / PGSIZE + pages > NUMBER_VIRTUAL_PAGES || pid == -1)
+	{
+		//Invalid address or size
+		*(long *)SystemCallData->Argument[4] = ERR_BAD_PARAM;
+		return;
+	}
+
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 10, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Lock
+	//Find the area with the same tag, or a free one
+	int area = -1;
+	for (i = 0; i < MAX_SHARED_AREAS; i++)
+	{
+		if (SharedAreas[i].used && strncmp(SharedAreas[i].tag, tag, MAX_SHARED_TAG) == 0)
+		{
+			area = i;
+			break;
+		}
+	}
+	if (area == -1)
+	{
+		for (i = 0; i < MAX_SHARED_AREAS; i++)
+		{
+			if (!SharedAreas[i].used)
+			{
+				area = i;
+				SharedAreas[i].used = 1;
+				strncpy(SharedAreas[i].tag, tag, MAX_SHARED_TAG - 1);
+				SharedAreas[i].tag[MAX_SHARED_TAG - 1] = '\0';
+				SharedAreas[i].pages = pages;
+				SharedAreas[i].definers = 0;
+				SharedAreas[i].mappers = 0;
+				for (int j = 0; j < MAX_SHARED_PAGES; j++)
+				{
+					SharedAreas[i].frames[j] = -1;
+					SharedAreas[i].slots[j] = -1;
+					SharedAreas[i].changes[j] = 0;
+				}
+				break;
+			}
+		}
+	}
+
+	//Find a free mapping slot of this process
+	int slot = -1;
+	for (i = 0; i < MAX_SHARED_AREAS; i++)
+	{
+		if (SharedMappings[pid][i].area == -1)
+		{
+			slot = i;
+			break;
+		}
+	}
+
+	if (area == -1 || slot == -1 || SharedAreas[area].pages != pages)
+	{
+		//Too many areas, or the size doesn't match the area
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 10, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);//Unlock
+		*(long *)SystemCallData->Argument[4] = ERR_BAD_PARAM;
+		return;
+	}
+
+	SharedMappings[pid][slot].area = area;
+	SharedMappings[pid][slot].start = start / PGSIZE;
+	*(long *)SystemCallData->Argument[3] = SharedAreas[area].definers;
+	SharedAreas[area].definers++;
+	AddAreaMapper(area);
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 10, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Unlock
+	*(long *)SystemCallData->Argument[4] = ERR_SUCCESS;
+}
+
+/************************************************************************
+ SharedFault
+ Function used by the fault handler for a page of a shared area.
+ A page another process has brought in is mapped at once. Otherwise a
+ physical page is taken for it and the page is read back if the area
+ has written it out, all without the lock of the shared areas, since
+ that waits for the disk. If the page came in or went out meanwhile,
+ the physical page is given back and the fault looks again.
+ return 1 if the page was read back.
+ ************************************************************************/
+int SharedFault(int pid, int page, int area, int index) {
+	struct SharedArea *sa = &SharedAreas[area];
+	unsigned char data[MAX_PGSIZE];
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 10, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Lock
+	int frame = sa->frames[index];
+	if (frame != -1)
+	{
+		//Another process has brought this page in, use the same physical page
+		*PageEntry(pid, page) = (UINT16)PTBL_VALID_BIT + (UINT16)frame;
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 10, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);//Unlock
+		MemoryPrinter(frame);
+		return 0;
+	}
+	int changes = sa->changes[index];
+	int slot = sa->slots[index];
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 10, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Unlock
+
+	frame = getFreePhysicalPage();
+	if (frame == -1)
+	{
+		FaultEvictions++;
+		long outstart = ReadClock();
+		frame = WriteVictim(pid, page);//Maps the victim for the page
+		FaultPhase[pid][PHASE_OUT] += ReadClock() - outstart - FaultPhase[pid][PHASE_SELECT];
+	}
+	else
+	{
+		*PageEntry(pid, page) = (UINT16)PTBL_VALID_BIT + (UINT16)frame;
+		Blocks[pid].Memory[frame] = page;
+		MemoryOwner[frame] = pid;
+		MemoryOrder[frame] = clock;
+		MemoryAddress[frame] = page;
+		MemoryBusy[frame] = 1;
+		clock++;
+	}
+	if (slot != -1)
+	{
+		long instart = ReadClock();
+		SwapRead(slot, (char *)data);
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		Z502WritePhysicalMemory(frame, (char *)data);
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		FaultPhase[pid][PHASE_IN] += ReadClock() - instart;
+		PageIns++;
+	}
+
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 10, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Lock
+	if (sa->changes[index] != changes)
+	{
+		//Brought in by another process while the disk was busy, or written out again
+		MemoryBusy[frame] = 0;
+		releasePhysicalPage(frame);
+		*PageEntry(pid, page) = 0;
+		InvalidateTLB(pid, page);
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 10, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);//Unlock
+		return SharedFault(pid, page, area, index);
+	}
+	sa->frames[index] = frame;
+	sa->changes[index]++;
+	if (slot != -1)
+	{
+		//Written again when it is chosen next time
+		releaseSwap(slot);
+		sa->slots[index] = -1;
+	}
+	MemoryShared[frame] = sa->mappers;
+	MemoryArea[frame] = area * MAX_SHARED_PAGES + index;
+	MemoryState[frame] = 1;
+	MemoryBusy[frame] = 0;
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 10, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Unlock
+	MemoryPrinter(frame);
+	return slot != -1;
+}
+
+/************************************************************************
+ AddAreaMapper
+ Function used under the lock of the shared areas when one more process
+ maps an area. Each page of the area in memory counts it.
+ ************************************************************************/
+void AddAreaMapper(int area) {
+	struct SharedArea *sa = &SharedAreas[area];
+	sa->mappers++;
+	for (int j = 0; j < sa->pages; j++)
+	{
+		if (sa->frames[j] != -1)
+		{
+			MemoryShared[sa->frames[j]]++;
+		}
+	}
+}
+
+/************************************************************************
+ SharedReferenced
+ Function used by the clock hand for a page of a shared area.
+ return 1 if any process mapping the page has used it; the referenced
+ bits of all of them are cleared.
+ ************************************************************************/
+int SharedReferenced(int frame) {
+	int area = MemoryArea[frame] / MAX_SHARED_PAGES;
+	int index = MemoryArea[frame] % MAX_SHARED_PAGES;
+	int referenced = 0;
+	for (int q = 0; q < PID; q++)
+	{
+		for (int m = 0; Blocks[q].status != 0 && m < MAX_SHARED_AREAS; m++)
+		{
+			struct SharedMapping *sm = &SharedMappings[q][m];
+			if (sm->area != area)
+			{
+				continue;
+			}
+			UINT16 entry = (UINT16)PageValue(q, sm->start + index);
+			if ((entry & PTBL_VALID_BIT) && (entry & PTBL_PHYS_PG_NO) == frame
+				&& (entry & PTBL_REFERENCED_BIT))
+			{
+				referenced = 1;
+				*PageEntry(q, sm->start + index) = entry & ~PTBL_REFERENCED_BIT;
+			}
+		}
+	}
+	return referenced;
+}
+
+/************************************************************************
+ SwapOutShared
+ Function used when a page of a shared area is chosen as a victim.
+ Every process mapping it loses it and faults it back in from the new
+ swap slot, which the area keeps for the page.
+ return the slot to write, -1 if no swap slot is left.
+ ************************************************************************/
+int SwapOutShared(int frame) {
+	int area = MemoryArea[frame] / MAX_SHARED_PAGES;
+	int index = MemoryArea[frame] % MAX_SHARED_PAGES;
+	int slot = findFreeSwap(-1, 0);
+	if (slot == -1)
+	{
+		return -1;
+	}
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 10, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Lock
+	for (int q = 0; q < PID; q++)
+	{
+		for (int m = 0; Blocks[q].status != 0 && m < MAX_SHARED_AREAS; m++)
+		{
+			struct SharedMapping *sm = &SharedMappings[q][m];
+			if (sm->area != area)
+			{
+				continue;
+			}
+			UINT16 entry = (UINT16)PageValue(q, sm->start + index);
+			if ((entry & PTBL_VALID_BIT) && (entry & PTBL_PHYS_PG_NO) == frame)
+			{
+				*PageEntry(q, sm->start + index) = 0;
+				InvalidateTLB(q, sm->start + index);
+			}
+		}
+	}
+	SharedAreas[area].frames[index] = -1;
+	SharedAreas[area].slots[index] = slot;
+	SharedAreas[area].changes[index]++;
+	MemoryShared[frame] = 0;
+	MemoryArea[frame] = -1;
+	SharedEvictions++;
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 10, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);//Unlock
+	return slot;
+}
+
+/************************************************************************
+ findFileMapping
+ Function used for checking whether a logical page of a process is in
+ one of the files it has mapped.
+ return the mapping and put the page number inside the file into
+ *index, or return -1 if the page is not in a mapped file.
+ ************************************************************************/
+int findFileMapping(int pid, int page, int *index) {
+	for (int i = 0; i < MAX_FILE_MAPPINGS; i++)
+	{
+		struct FileMapping *fm = &FileMappings[pid][i];
+		if (fm->inode != -1 && page >= fm->start && page < fm->start + MAPPED_PAGES)
+		{
+			*index = page - fm->start;
+			return i;
+		}
+	}
+	return -1;
+}
+
+/************************************************************************
+ MappedPageFresh
+ Function used for checking whether a page of a mapped file holds a
+ block which has its sector but was never written, it must be written
+ back even when it is not modified.
+ ************************************************************************/
+int MappedPageFresh(int pid, int map, int index) {
+	for (int k = 0; k < SWAP_PAGE_SECTORS; k++)
+	{
+		int block = index * SWAP_PAGE_SECTORS + k;
+		if (block < FILE_BLOCKS && FileMappings[pid][map].fresh[block])
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/************************************************************************
+ ReadMappedPage, WriteMappedPage
+ Functions used for moving one page of a mapped file between memory and
+ the data sectors of its blocks, a sector at a time.  The sectors come
+ from the index read by MapFile, so no index sector is read here.
+ A block which was never written reads as zeros.
+ ************************************************************************/
+void ReadMappedPage(int pid, int map, int index, int frame) {
+	MEMORY_MAPPED_IO mmio;
+	char data[MAX_PGSIZE];
+	struct FileMapping *fm = &FileMappings[pid][map];
+	memset(data, 0, PGSIZE);
+	for (int k = 0; k < SWAP_PAGE_SECTORS; k++)
+	{
+		int block = index * SWAP_PAGE_SECTORS + k;
+		if (block >= FILE_BLOCKS || fm->fresh[block])
+		{
+			continue;
+		}
+		mmio.Mode = Z502DiskRead;
+		mmio.Field1 = fm->did;
+		mmio.Field2 = fm->index[block];
+		mmio.Field3 = (long)(data + k * DISK_SECTOR_SIZE);
+		DoDisk(mmio);
+	}
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	Z502WritePhysicalMemory(frame, data);
+	READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+		&LockResult);
+	MappedReads++;
+}
+
+void WriteMappedPage(int pid, int map, int index, char *data) {
+	MEMORY_MAPPED_IO mmio;
+	int sectors[SWAP_PAGE_SECTORS];
+	int did = FileMappings[pid][map].did;
+	//Taken before the first write, the owner may fault on the page or unmap the file meanwhile
+	for (int k = 0; k < SWAP_PAGE_SECTORS; k++)
+	{
+		int block = index * SWAP_PAGE_SECTORS + k;
+		sectors[k] = (block < FILE_BLOCKS) ? FileMappings[pid][map].index[block] : 0;
+		if (block < FILE_BLOCKS)
+		{
+			FileMappings[pid][map].fresh[block] = 0;
+		}
+	}
+	for (int k = 0; k < SWAP_PAGE_SECTORS; k++)
+	{
+		if (sectors[k] == 0)
+		{
+			continue;
+		}
+		mmio.Mode = Z502DiskWrite;
+		mmio.Field1 = did;
+		mmio.Field2 = sectors[k];
+		mmio.Field3 = (long)(data + k * DISK_SECTOR_SIZE);
+		DoDisk(mmio);
+	}
+	MappedWrites++;
+}
+
+/************************************************************************
+ FlushMappedPage
+ Function used for writing one page of a mapped file back when it has
+ changed.  When keep is clear the page is also taken away from the
+ process, and its physical page is given back.
+ ************************************************************************/
+void FlushMappedPage(int pid, int map, int index, int keep) {
+	char data[MAX_PGSIZE];
+	int page = FileMappings[pid][map].start + index;
+	UINT16 entry = (UINT16)PageValue(pid, page);
+	int frame = entry & PTBL_PHYS_PG_NO;
+	int fresh = MappedPageFresh(pid, map, index);
+
+	if (!(entry & PTBL_VALID_BIT))
+	{
+		if (fresh)
+		{
+			//Never used, the blocks given a sector by the mapping are written as zeros
+			memset(data, 0, PGSIZE);
+			WriteMappedPage(pid, map, index, data);
+		}
+		return;
+	}
+	if (!ClaimFrame(frame))
+	{
+		return;//Being written back by an eviction already
+	}
+	if ((entry & PTBL_MODIFIED_BIT) || fresh)
+	{
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_LOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		Z502ReadPhysicalMemory(frame, data);
+		READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
+			&LockResult);
+		//Cleared before the write, so a write meanwhile marks the page again
+		*PageEntry(pid, page) = keep ? (entry & ~PTBL_MODIFIED_BIT) : 0;
+		InvalidateTLB(pid, page);
+		WriteMappedPage(pid, map, index, data);
+	}
+	else if (!keep)
+	{
+		*PageEntry(pid, page) = 0;
+		InvalidateTLB(pid, page);
+	}
+	MemoryBusy[frame] = 0;
+	if (!keep)
+	{
+		releasePhysicalPage(frame);
+		MemoryPrinter(frame);
+	}
+}
+
+/************************************************************************
+ MapFile
+ Function used for doing the MAP_FILE system call.
+ Argument[0] is the inode of an opened file, Argument[1] is the page
+ aligned logical address and Argument[2] returns the error.
+ The FILE_BLOCKS blocks of the file take MAPPED_PAGES logical pages,
+ which must not be used yet.  The index sector is read once here; the
+ fault handler then reads each page straight from its data sectors, so
+ a scan of the file takes one disk read a block and no system call.
+ Blocks which were never written get their sectors now, while the
+ current disk of the process is the one of the file.
+ ************************************************************************/
+void MapFile(SYSTEM_CALL_DATA *SystemCallData) {
+	int inode = (int)(long)SystemCallData->Argument[0];
+	long start = (long)SystemCallData->Argument[1];
+	int pid = getCurrentPID();
+	MEMORY_MAPPED_IO mmio;
+	unsigned char header[16];
+	int map = -1;
+	int index;
+	int i;
+
+	if (inode < 0 || inode >= Inode || FDIs[inode].flag != 0 || start < 0 || start % PGSIZE != 0
+		|| start / PGSIZE + MAPPED_PAGES > NUMBER_VIRTUAL_PAGES || pid == -1)
+	{
+		//Not a file, or an invalid address
+		*(long *)SystemCallData->Argument[2] = ERR_BAD_PARAM;
+		return;
+	}
+	for (i = 0; i < MAX_FILE_MAPPINGS; i++)
+	{
+		if (FileMappings[pid][i].inode == -1)
+		{
+			map = i;
+			break;
+		}
+	}
+	for (i = 0; i < MAPPED_PAGES && map != -1; i++)
+	{
+		int page = start / PGSIZE + i;
+		if (PageValue(pid, page) != 0 || findSharedArea(pid, page, &index) != -1
+			|| findFileMapping(pid, page, &index) != -1)
+		{
+			map = -1;//The page is used already
+		}
+	}
+	if (map == -1)
+	{
+		*(long *)SystemCallData->Argument[2] = ERR_BAD_PARAM;
+		return;
+	}
+
+	struct FileMapping *fm = &FileMappings[pid][map];
+	fm->did = FDIs[inode].did;
+	fm->start = start / PGSIZE;
+
+	mmio.Mode = Z502DiskRead;
+	mmio.Field1 = fm->did;
+	mmio.Field2 = FDIs[inode].ptr;
+	mmio.Field3 = (long)header;
+	DoDisk(mmio);
+	fm->indexsector = header[13] * 256 + header[12];
+
+	mmio.Mode = Z502DiskRead;
+	mmio.Field1 = fm->did;
+	mmio.Field2 = fm->indexsector;
+	mmio.Field3 = (long)fm->index;
+	DoDisk(mmio);
+
+	int added = 0;
+	for (i = 0; i < FILE_BLOCKS; i++)
+	{
+		fm->fresh[i] = 0;
+		if (fm->index[i] == 0)
+		{
+			//The sector WRITE_FILE would use for this block
+			fm->index[i] = fm->indexsector + 1 + i;
+			fm->fresh[i] = 1;
+			writeBitMap(fm->index[i], 0);
+			added = 1;
+		}
+	}
+	if (added)
+	{
+		mmio.Mode = Z502DiskWrite;
+		mmio.Field1 = fm->did;
+		mmio.Field2 = fm->indexsector;
+		mmio.Field3 = (long)fm->index;
+		DoDisk(mmio);
+	}
+	fm->inode = inode;//Only now the fault handler sees the mapping
+	FilesMapped++;
+	*(long *)SystemCallData->Argument[2] = ERR_SUCCESS;
+}
+
+/************************************************************************
+ UnmapFile
+ Function used for doing the UNMAP_FILE system call.
+ Argument[0] is the logical address given to MAP_FILE and Argument[1]
+ returns the error.  The changed pages are written back to the file.
+ ************************************************************************/
+void UnmapFile(SYSTEM_CALL_DATA *SystemCallData) {
+	long start = (long)SystemCallData->Argument[0];
+	int pid = getCurrentPID();
+	for (int i = 0; i < MAX_FILE_MAPPINGS && pid != -1; i++)
+	{
+		struct FileMapping *fm = &FileMappings[pid][i];
+		if (fm->inode != -1 && start % PGSIZE == 0 && fm->start == start / PGSIZE)
+		{
+			DropFileMapping(pid, i);
+			*(long *)SystemCallData->Argument[1] = ERR_SUCCESS;
+			return;
+		}
+	}
+	*(long *)SystemCallData->Argument[1] = ERR_BAD_PARAM;
+}
+
+/************************************************************************
+ DropFileMapping, UnmapFiles
+ Functions used for unmapping one file of a process, or all the files
+ of a terminating process.  The changed pages are written back first.
+ ************************************************************************/
+void DropFileMapping(int pid, int map) {
+	for (int j = 0; j < MAPPED_PAGES; j++)
+	{
+		FlushMappedPage(pid, map, j, 0);
+	}
+	FileMappings[pid][map].inode = -1;
+}
+
+void UnmapFiles(int pid) {
+	for (int i = 0; i < MAX_FILE_MAPPINGS; i++)
+	{
+		if (FileMappings[pid][i].inode != -1)
+		{
+			DropFileMapping(pid, i);
+		}
+	}
+}
+
+/************************************************************************
+ SyncMappedFiles
+ Function used by CHECK_DISK for writing back the changed pages of all
+ the files mapped on a disk.  The pages stay mapped.
+ ************************************************************************/
+void SyncMappedFiles(int did) {
+	for (int pid = 0; pid < PID; pid++)
+	{
+		if (Blocks[pid].status == 0)
+		{
+			continue;
+		}
+		for (int i = 0; i < MAX_FILE_MAPPINGS; i++)
+		{
+			if (FileMappings[pid][i].inode == -1 || FileMappings[pid][i].did != did)
+			{
+				continue;
+			}
+			for (int j = 0; j < MAPPED_PAGES; j++)
+			{
+				FlushMappedPage(pid, i, j, 1);
+			}
+		}
+	}
+}
+
+/************************************************************************
+ SchedulerReport
+ Function used for printing the CPU share of each process against the
+ share its weight asks for.
+ ************************************************************************/
+void SchedulerReport() {
+	long totaltime = 0;
+	long totalweight = 0;
+	for (int i = 0; i < PID; i++)
+	{
+		totaltime += Blocks[i].cputime;
+		totalweight += Blocks[i].weight;
+	}
+	if (totaltime == 0)
+	{
+		totaltime = 1;
+	}
+	if (totalweight == 0)
+	{
+		totalweight = 1;
+	}
+
+	aprintf("\n------------------------ CPU Share Report ------------------------\n");
+	aprintf(" PID  Name              Prio  Weight   CPU Time  CPU Share  Weight Share  Vruntime\n");
+	for (int i = 0; i < PID; i++)
+	{
+		aprintf(" %3d  %-16s  %4ld  %6d  %9ld  %8.2f%%  %11.2f%%  %8ld\n",
+			(int)Blocks[i].pid, Blocks[i].name, Blocks[i].order, Blocks[i].weight,
+			Blocks[i].cputime, 100.0 * Blocks[i].cputime / totaltime,
+			100.0 * Blocks[i].weight / totalweight, Blocks[i].vruntime);
+	}
+	aprintf("------------------------------------------------------------------\n");
 }
 
 /************************************************************************
- checkFull
- Function used for checking whether there are any free physical pages or not.
+ Timestamp
+ Function used for recording the time of a queue transition of a process.
+ The time comes from the Z502 clock.  Leaving the ready queue, the disk
+ queue or the timer queue adds a latency sample of that process.
  ************************************************************************/
-int checkFull() {
-	for (int i = 0; i < 64; i ++ )
-	{
-		if (MemoryOwner[i] == -1)
+void Timestamp(int pid, int event) {
+	MEMORY_MAPPED_IO    mmio;      // Enables communication with hardware
+
+	//Get the current time
+	mmio.Mode = Z502ReturnValue;
+	mmio.Field1 = mmio.Field2 = mmio.Field3 = mmio.Field4 = 0;
+	MEM_READ(Z502Clock, &mmio);
+	int nowtime = (int)mmio.Field1;
+
+	struct LatencyRecord *lr = &Latency[pid];
+	switch (event) {
+	case EVENT_CREATE:
+		Blocks[pid].ctime = nowtime;
+		Blocks[pid].waitkind = EVENT_CREATE;
+		lr->nready = lr->nio = lr->nlate = 0;//This PCB may be used by a terminated process before
+		break;
+	case EVENT_READY:
+		Blocks[pid].rtime = nowtime;
+		break;
+	case EVENT_DISPATCH:
+		lr->readywait[lr->nready % LATENCY_SAMPLES] = nowtime - Blocks[pid].rtime;
+		lr->nready++;
+		break;
+	case EVENT_SLEEP:
+	case EVENT_DISKWAIT:
+		Blocks[pid].wtime = nowtime;
+		Blocks[pid].waitkind = event;
+		break;
+	case EVENT_WAKE:
+		if (Blocks[pid].waitkind == EVENT_SLEEP)
 		{
-			return 0;
+			lr->lateness[lr->nlate % LATENCY_SAMPLES] = nowtime - Blocks[pid].ptime;
+			lr->nlate++;
+		}
+		else if (Blocks[pid].waitkind == EVENT_DISKWAIT)
+		{
+			lr->iowait[lr->nio % LATENCY_SAMPLES] = nowtime - Blocks[pid].wtime;
+			lr->nio++;
 		}
+		Blocks[pid].waitkind = EVENT_WAKE;
+		break;
+	case EVENT_TERMINATE:
+		Blocks[pid].etime = nowtime;
+		break;
 	}
-	//printf("full!\n");
-	return 1;
+}
+
+//Used by qsort for sorting the latency samples
+int CompareSample(const void *a, const void *b) {
+	return *(const int *)a - *(const int *)b;
 }
 
 /************************************************************************
- initSwap
- Function used for initializing the swap area.
+ PrintPercentiles
+ Function used for printing one line of the latency report.
+ The samples are sorted in place, then p50/p95/p99 and max are printed.
  ************************************************************************/
-void initSwap() {
-	for (int i = 0; i < 400; i++)
+void PrintPercentiles(char *who, char *kind, int *samples, int count) {
+	if (count == 0)
 	{
-		Swap[i].used = -1;
+		return;
 	}
+	qsort(samples, count, sizeof(int), CompareSample);
+	aprintf(" %-16s  %-10s  %6d  %7d  %7d  %7d  %7d\n", who, kind, count,
+		samples[(count * 50 + 99) / 100 - 1], samples[(count * 95 + 99) / 100 - 1],
+		samples[(count * 99 + 99) / 100 - 1], samples[count - 1]);
 }
+
 /************************************************************************
- ReadBack
- Function used for reading back a page stored in disk.
+ LatencyReport
+ Function used for printing the ready-wait, I/O-wait and wake-up lateness
+ of each process and of the whole system.  When latencycsv is set, all
+ the samples are also written to latency.csv.
  ************************************************************************/
-void ReadBack(int pid, int victim, int DiskStatus) {
-	MEMORY_MAPPED_IO mmio;
-	unsigned char readswapdisk[PGSIZE];
-	char writeswapmemory[PGSIZE];
-	int place;
-	for (int i = 0; i < 400; i++)
+void LatencyReport() {
+	static int all[3][14 * LATENCY_SAMPLES];//Samples of all the processes
+	int nall[3] = { 0, 0, 0 };
+	char *kinds[3] = { "ready-wait", "io-wait", "lateness" };
+	FILE *csv = NULL;
+
+	if (latencycsv)
 	{
-		if (Swap[i].used==1 && Swap[i].regadd == DiskStatus && Swap[i].regid == pid)
+		csv = fopen("latency.csv", "w");
+		if (csv != NULL)
 		{
-			place = i;
-			break;
+			fprintf(csv, "pid,name,kind,value\n");
 		}
 	}
 
-	mmio.Mode = Z502DiskRead;
-	mmio.Field1 = 1;
-	mmio.Field2 = 13 + place;
-	mmio.Field3 = (long)readswapdisk;
-	DoDisk(mmio);
-	for (int i = 0; i < 16; i++)
+	aprintf("\n------------------------- Latency Report -------------------------\n");
+	aprintf(" %-16s  %-10s  %6s  %7s  %7s  %7s  %7s\n", "Process", "Kind", "Count", "p50", "p95", "p99", "Max");
+	for (int i = 0; i < PID; i++)
 	{
-		writeswapmemory[i] = (char)readswapdisk[i];
+		struct LatencyRecord *lr = &Latency[i];
+		int *samples[3] = { lr->readywait, lr->iowait, lr->lateness };
+		int counts[3] = { lr->nready, lr->nio, lr->nlate };
+		for (int k = 0; k < 3; k++)
+		{
+			int n = (counts[k] < LATENCY_SAMPLES) ? counts[k] : LATENCY_SAMPLES;
+			for (int j = 0; j < n; j++)
+			{
+				all[k][nall[k]++] = samples[k][j];
+				if (csv != NULL)
+				{
+					fprintf(csv, "%d,%s,%s,%d\n", (int)Blocks[i].pid, Blocks[i].name, kinds[k], samples[k][j]);
+				}
+			}
+			PrintPercentiles(Blocks[i].name, kinds[k], samples[k], n);
+		}
 	}
-	READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_LOCK, SUSPEND_UNTIL_LOCKED,
-		&LockResult);
-	Z502WritePhysicalMemory(victim, (char *)writeswapmemory);
-	READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
-		&LockResult);
-	Swap[place].used = -1;
-	Swap[place].regid = 0;
-	Swap[place].regadd = 0;
-}
-
-int WriteVictim(int pid, int MemoryStatus) {
-
-	int freeplace = findFreeSwap(pid);
-
-	writeBitMap(13 + freeplace,1);
-
-	int victim = getVictim(pid);
-	int DiskStatus = Blocks[pid].Memory[victim];
-	char readswap[PGSIZE];
-	MEMORY_MAPPED_IO mmio;
-
-
-	PAGE_TBL_ADDR[MemoryStatus] = (UINT16)PTBL_VALID_BIT + (UINT16)victim;
-	PAGE_TBL_ADDR[DiskStatus] = (UINT16)2;
-
-	READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_LOCK, SUSPEND_UNTIL_LOCKED,
-		&LockResult);
-	Z502ReadPhysicalMemory(victim, (char *)readswap);
-	READ_MODIFY(MEMORY_INTERLOCK_BASE + 6, DO_UNLOCK, SUSPEND_UNTIL_LOCKED,
-		&LockResult);
-	/*if (Blocks[pid].swapinit == 0)
+	for (int k = 0; k < 3; k++)
 	{
-		initSwap(pid);
-		Blocks[pid].swapinit = 1;
-	}*/
-
-	unsigned char writeswap[PGSIZE];
+		PrintPercentiles("All", kinds[k], all[k], nall[k]);
+	}
+	aprintf("------------------------------------------------------------------\n");
 
-	for (int i = 0; i < 16; i++)
+	if (csv != NULL)
 	{
-		writeswap[i] = (unsigned char)readswap[i];
+		fclose(csv);
+		aprintf("Latency samples are written to latency.csv\n");
 	}
+}
 
-
-
-	mmio.Mode = Z502DiskWrite;
-	mmio.Field1 = 1;
-	mmio.Field2 = 13+freeplace;
-	mmio.Field3 = (long)writeswap;
-	DoDisk(mmio);
-
-	
-
-	Swap[freeplace].regadd = DiskStatus;
-	Blocks[pid].Memory[victim] = MemoryStatus;
-	MemoryOrder[victim] = clock;
-
-	MemoryAddress[victim] = MemoryStatus;
-	MemoryState[victim] = 2;
-	MemoryPrinter();
-
-	clock++;
-
-	return victim;
+/************************************************************************
+ PrintFaultStats
+ Function used for printing one line of the fault time breakdown,
+ the mean time of each part of the faults.
+ ************************************************************************/
+void PrintFaultStats(char *who, struct FaultStats *fs) {
+	if (fs->faults == 0)
+	{
+		return;
+	}
+	aprintf("   %-16s %6ld %6ld %6ld", who, fs->faults, fs->minor, fs->major);
+	for (int k = 0; k < FAULT_PHASES; k++)
+	{
+		aprintf(" %8ld", fs->phase[k] / fs->faults);
+	}
+	aprintf("\n");
 }
+
 /************************************************************************
- findFreeSwap
- Function used for finding a free swap sector.
+ PagingReport
+ Function used for printing the statistics of the pager.
  ************************************************************************/
-int findFreeSwap(int pid) {
-	for (int i = 0; i < 400; i++)
+void PagingReport() {
+	MEMORY_MAPPED_IO mmio;
+	aprintf("\n------------------------- Paging Report --------------------------\n");
+	aprintf(" Replacement policy:   %s\n", (ReplacePolicy == POLICY_CLOCK) ? "CLOCK" : "FIFO");
+	aprintf(" Page faults:          %ld\n", PageFaults);
+	aprintf(" Pages written out:    %ld\n", PageOuts);
+	aprintf(" Swap writes avoided:  %ld\n", SwapWritesAvoided);
+	aprintf(" Pages read back:      %ld\n", PageIns);
+	aprintf(" Freed by pageout:     %ld\n", PageoutEvictions);
+	aprintf(" Faults evicting:      %ld\n", FaultEvictions);
+	aprintf(" Faults waiting:       %ld\n", FrameWaits);
+	aprintf(" Waits for writes:     %ld\n", WriteWaits);
+	aprintf(" Shared pages out:     %ld\n", SharedEvictions);
+	aprintf(" Mean fault time:      %ld\n", FaultTimeTotal / PageFaults);
+	aprintf(" Prefetch window:      %d\n", PrefetchWindow);
+	aprintf(" Pages prefetched:     %ld\n", PrefetchReads);
+	aprintf(" Prefetch hits:        %ld\n", PrefetchHits);
+	aprintf(" Prefetch wasted:      %ld\n", PrefetchWasted);
+	aprintf(" Prefetch dropped:     %ld\n", PrefetchDropped);
+	aprintf(" Prefetch turned off:  %ld\n", PrefetchBackoffs);
+	aprintf(" Quota grows/shrinks:  %ld/%ld\n", QuotaGrows, QuotaShrinks);
+	aprintf(" Local evictions:      %ld\n", LocalEvictions);
+	aprintf(" Load suspensions:     %ld\n", LoadSuspends);
+	aprintf(" Resumed when idle:    %ld\n", IdleResumes);
+	aprintf(" Reclaimed at exit:    %ld processes, %ld pages, %ld swap slots, %ld leaves\n",
+		ProcessesReclaimed, ReclaimedFrames, ReclaimedSwapSlots, ReclaimedLeaves);
+	aprintf(" Copy-on-write:        %ld forks, %ld pages shared, %ld copied, %ld reused\n",
+		CowForks, CowShared, CowCopies, CowReuses);
+	aprintf(" Mapped files:         %ld mapped, %ld pages read, %ld written back\n",
+		FilesMapped, MappedReads, MappedWrites);
+	aprintf(" Swap disks:           %d\n", SwapDiskCount);
+	aprintf(" Writes moved to a less busy disk: %ld\n", SwapMoves);
+	aprintf("   Disk  Reads  Writes  Requests  Mean time\n");
+	for (int d = 0; d < SwapDiskCount; d++)
 	{
-		if (Swap[i].used == -1) {
-			Swap[i].used = 1;
-			Swap[i].regid = pid;
-			return i;
+		int disk = SwapDiskIds[d];
+		aprintf("   %4d %6ld %7ld %9ld %10ld\n", disk, SwapDiskReads[d], SwapDiskWrites[d],
+			DiskRequests[disk], DiskRequests[disk] ? DiskTime[disk] / DiskRequests[disk] : 0);
+	}
+	mmio.Mode = Z502ReturnValue;
+	mmio.Field1 = mmio.Field2 = mmio.Field3 = mmio.Field4 = 0;
+	MEM_READ(Z502Clock, &mmio);
+	long pagingtime = mmio.Field1 - FirstFaultTime;
+	if (ZCacheSize > 0)
+	{
+		aprintf(" Swap cache pages:     %d\n", ZCacheSize);
+		aprintf(" Swap cache stores:    %ld (%ld did not compress)\n", ZCacheStores, ZCacheRejects);
+		aprintf(" Swap cache hits:      %ld (%ld%% of the pages read back)\n", ZCacheHits,
+			(ZCacheHits + PageIns) ? ZCacheHits * 100 / (ZCacheHits + PageIns) : 0);
+		aprintf(" Swap cache push outs: %ld, dropped: %ld\n", ZCachePushOuts, ZCacheDropped);
+		aprintf(" Compression ratio:    %ld.%02ld\n", ZCacheBytesOut ? ZCacheBytesIn / ZCacheBytesOut : 0,
+			ZCacheBytesOut ? ZCacheBytesIn * 100 / ZCacheBytesOut % 100 : 0);
+		aprintf(" Disk I/O avoided:     %ld\n", ZCacheHits + ZCacheStores - ZCachePushOuts);
+	}
+	aprintf(" Paging throughput:    %ld pages per 10000 time units\n",
+		pagingtime > 0 ? (PageIns + PageOuts + PrefetchReads) * 10000 / pagingtime : 0);
+	aprintf(" Page table memory (a flat table takes %d bytes):\n",
+		(int)(NUMBER_VIRTUAL_PAGES * sizeof(short)));
+	aprintf("   PID  Leaves  Bytes\n");
+	for (int i = 0; i < PID; i++)
+	{
+		aprintf("   %3d %7d %6d\n", i, Blocks[i].leaves, Blocks[i].PageTable == NULL ? 0 :
+			(int)(PTBL_DIRECTORY_ENTRIES * sizeof(short *) + Blocks[i].leaves * PTBL_LEAF_PAGES * sizeof(short)));
+	}
+	aprintf(" Minor/major faults:   %ld/%ld\n", AllFaults.minor, AllFaults.major);
+	aprintf(" Mean fault time by part:\n");
+	aprintf("   %-16s %6s %6s %6s", "Process", "Faults", "Minor", "Major");
+	for (int k = 0; k < FAULT_PHASES; k++)
+	{
+		aprintf(" %8s", PhaseNames[k]);
+	}
+	aprintf("\n");
+	for (int i = 0; i < PID; i++)
+	{
+		PrintFaultStats(Blocks[i].name, &ProcessFaults[i]);
+	}
+	PrintFaultStats("All", &AllFaults);
+	aprintf(" Fault time histogram:\n");
+	for (int i = 0; i < FAULT_BUCKETS; i++)
+	{
+		if (FaultHistogram[i] > 0)
+		{
+			aprintf("   < %6ld: %6ld\n", 1L << i, FaultHistogram[i]);
 		}
 	}
-	//printf("\nfull!\n");
-	return -1;
+	aprintf("------------------------------------------------------------------\n");
 }
 
-
 /************************************************************************
- dispatcher
- Function used for running the processes in ready queue.
+ HaltSystem
+ Function used for stopping the simulation.
+ Prints the reports of the OS before halting the hardware.
  ************************************************************************/
-void dispatcher() {
-
+void HaltSystem() {
 	MEMORY_MAPPED_IO    mmio;      // Enables communication with hardware
-	while (ReadyEmpty()) {
-		//When ready queue is empty, keep on waiting.
-		CALL(WasteTime());
-	}
-
-	
-	int retpid=ReadyReadPID(0);//Get the pid of the head of ready queue
-	//char *nm = ReadyReadName(0);
-
-
-
-	//printf("return PID: %d\n", retpid);
-	//printf("return Name: %s\n", nm);
-
 
-	RemoveReadyItem(&Blocks[retpid]);//Remove the head item from ready queue
-
-
-	CallSchedulePrinter(2,Blocks[retpid].pid);//Call the schedule printer for printing the status
-
-	//Start the corresponding process
-	mmio.Mode = Z502StartContext;
-	mmio.Field1 = Blocks[retpid].Context;
-	mmio.Field2 = START_NEW_CONTEXT_AND_SUSPEND;
-	mmio.Field3 = mmio.Field4 = 0;
-	MEM_WRITE(Z502Context, &mmio);
-	
+	ChargeRunningTime();//Charge the process which is running now
+	if (cfsprint > 0)
+	{
+		SchedulerReport();
+	}
+	if (latencyprint > 0)
+	{
+		LatencyReport();
+	}
+	if (PageFaults > 0)
+	{
+		PagingReport();
+	}
+	if (FaultTrace != NULL)
+	{
+		fclose(FaultTrace);
+		aprintf("Page faults are written to faults.csv\n");
+	}
 
+	//Stop the simulation
+	mmio.Mode = Z502Action;
+	mmio.Field1 = mmio.Field2 = mmio.Field3 = 0;
+	MEM_WRITE(Z502Halt, &mmio);
 }
 
 /************************************************************************
@@ -706,7 +4246,6 @@ void CallSchedulePrinter(int action, int target) {
 	SP_INPUT_DATA spip;//Initialize structure for input
 	MEMORY_MAPPED_IO    mmio;// Enables communication with hardware
 	spip.TargetPID = target;//Get the target PID
-	spip.NumberOfProcSuspendedProcesses = 0;//Now we don't need multiprocessor
 
 	//Get the current context
 	mmio.Mode = Z502GetCurrentContext;
@@ -754,6 +4293,22 @@ void CallSchedulePrinter(int action, int target) {
 	{
 		strcpy(spip.TargetAction, "DISK_READ");
 	}
+	else if (action == 6)
+	{
+		strcpy(spip.TargetAction, "SEND");
+	}
+	else if (action == 7)
+	{
+		strcpy(spip.TargetAction, "RECEIVE");
+	}
+	else if (action == 8)
+	{
+		strcpy(spip.TargetAction, "SUSPEND");
+	}
+	else if (action == 9)
+	{
+		strcpy(spip.TargetAction, "RESUME");
+	}
 	
 	//Get the status of ready queue
 	if (!ReadyEmpty())
@@ -866,7 +4421,37 @@ void CallSchedulePrinter(int action, int target) {
 	{
 		spip.NumberOfTerminatedProcesses = 0;
 	}
-	spip.NumberOfMessageSuspendedProcesses = 0;
+	//Get the status of suspend queue
+	int suspendpid;
+	countcurrent = 0;
+	while (countcurrent < 14)
+	{
+		suspendpid = SuspendReadPID(countcurrent);
+		if (suspendpid == -1)
+		{
+			//Reach the tail of the queue
+			break;
+		}
+		spip.ProcSuspendedProcessPIDs[countcurrent] = suspendpid;
+		countcurrent++;
+	}
+	spip.NumberOfProcSuspendedProcesses = countcurrent;
+
+	//Get the status of message queue
+	int messagepid;
+	countcurrent = 0;
+	while (countcurrent < 14)
+	{
+		messagepid = MessageReadPID(countcurrent);
+		if (messagepid == -1)
+		{
+			//Reach the tail of the queue
+			break;
+		}
+		spip.MessageSuspendedProcessPIDs[countcurrent] = messagepid;
+		countcurrent++;
+	}
+	spip.NumberOfMessageSuspendedProcesses = countcurrent;
 	READ_MODIFY(MEMORY_INTERLOCK_BASE + 5, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 		&LockResult);
 	SPPrintLine(&spip);//Print the status
@@ -898,7 +4483,7 @@ void svc(SYSTEM_CALL_DATA *SystemCallData) {
 	MEMORY_MAPPED_IO    mmio2;
 	INT32 Status;
 	char *psname;//Used for getting name for getting PID
-	char *pname;//Used for getting name for creating new process
+	char pname[20];//Used for getting name for creating new process
 	unsigned char writedata[16];
 	unsigned char readdata[16];
 	UINT16 index[8];
@@ -951,9 +4536,7 @@ void svc(SYSTEM_CALL_DATA *SystemCallData) {
 				if (Blocks[0].Context == (long)mmio.Field1)//Case of termination of the main process
 				{
 					//Stop the simulation
-					mmio.Mode = Z502Action;
-					mmio.Field1 = mmio.Field2 = mmio.Field3 = 0;
-					MEM_WRITE(Z502Halt, &mmio);
+					HaltSystem();
 				}
 				else
 				{
@@ -964,7 +4547,13 @@ void svc(SYSTEM_CALL_DATA *SystemCallData) {
 
 						if (Blocks[g].Context == mmio.Field1)
 						{
+							UnmapFiles(g);//Written back while it can still wait for the disk
 							Blocks[g].status = 0;
+							Timestamp(g, EVENT_TERMINATE);
+							Blocks[g].state = STATE_TERMINATED;
+							FreeMailbox(g);
+							FreeProcessMemory(g);
+							ResumeLoad();//Its quota is free now
 							
 							break;
 						}
@@ -987,7 +4576,8 @@ void svc(SYSTEM_CALL_DATA *SystemCallData) {
 							{
 								int retpid = TimerReadPID(0);//Get the pid of the head of timer queue
 								RemoveTimerItem(&Blocks[retpid]);//Remove the head item from timer queue
-								InsertReadyOrder(&Blocks[retpid], Blocks[retpid].order);//Insert the removed PCB to ready queue with corresponding order
+								Timestamp(retpid, EVENT_WAKE);
+								MakeReady(retpid);//Insert the removed PCB to ready queue with corresponding order
 							}
 						}
 
@@ -1000,23 +4590,26 @@ void svc(SYSTEM_CALL_DATA *SystemCallData) {
 			else if (SystemCallData->Argument[0] == -2)//Stop the simulation
 			{
 				//Stop the simulation.
-				mmio.Mode = Z502Action;
-				mmio.Field1 = mmio.Field2 = mmio.Field3 = 0;
-				MEM_WRITE(Z502Halt, &mmio);
+				HaltSystem();
 			}
 			else  //Stop a specific process (not running now)
 			{
 				int terid = (int)SystemCallData->Argument[0];//Get the pid of this process
 				//Find the PCB of this process
 				int checkterid;
+				*(long *)SystemCallData->Argument[1] = ERR_BAD_PARAM;//Unknown or already terminated
 				for (checkterid = 0; checkterid < PID; checkterid++)
 				{
-					if (Blocks[checkterid].pid == terid)
+					if (Blocks[checkterid].pid == terid && Blocks[checkterid].status != 0)
 					{
 						CallSchedulePrinter(3, Blocks[checkterid].pid);//Call the schedule printer
-						RemoveReadyItem(&Blocks[checkterid]);//Remove this PCB from ready queue
-						
-						PID--;//Let new process can replace the space of this process
+						Timestamp(checkterid, EVENT_TERMINATE);
+						LeaveQueue(checkterid);//Remove this PCB from the queue it is on
+						Blocks[checkterid].status = 0;
+						Blocks[checkterid].state = STATE_TERMINATED;
+						FreeMailbox(checkterid);
+						FreeProcessMemory(checkterid);
+						ResumeLoad();//Its quota is free now
 						*(long *)SystemCallData->Argument[1] = ERR_SUCCESS;
 					}
 				}
@@ -1095,12 +4688,6 @@ void svc(SYSTEM_CALL_DATA *SystemCallData) {
 			int wakeup = (int)SystemCallData->Argument[0];
 			wakeup += mmio.Field1;
 
-			//Start the timer
-			mmio.Mode = Z502Start;
-			mmio.Field1 = SystemCallData->Argument[0];
-			mmio.Field2 = mmio.Field3 = 0;
-			MEM_WRITE(Z502Timer, &mmio);
-
 			//Get the current context
 			mmio.Mode = Z502GetCurrentContext;
 			mmio.Field1 = mmio.Field2 = mmio.Field3 = mmio.Field4 = 0;
@@ -1116,20 +4703,28 @@ void svc(SYSTEM_CALL_DATA *SystemCallData) {
 					//printf("Sleep name: %s\n", Blocks[c].name);
 					//printf("wakeuptime: %d\n",wakeup);
 					Blocks[c].ptime = wakeup;//Set the wake-up time
+					Timestamp(c, EVENT_SLEEP);
+					Blocks[c].state = STATE_TIMER_WAIT;
+					Blocks[c].queue = QUEUE_TIMER;
 					InsertTimerOrder(&Blocks[c],wakeup);//Insert the corresponding PCB to the timer queue
 					
 					break;
 				}
 			}
+			if (TimerReadPID(0) == c)
+			{
+				//It wakes up first, start the timer for it. Otherwise the timer
+				//is already set for an earlier process, which starts it again later.
+				mmio.Mode = Z502Start;
+				mmio.Field1 = SystemCallData->Argument[0];
+				mmio.Field2 = mmio.Field3 = 0;
+				MEM_WRITE(Z502Timer, &mmio);
+			}
 			CallSchedulePrinter(1, Blocks[c].pid);//Call the schedule printer
 			
 			dispatcher();//Call the dispatcher to run another process
-
-			
-			//Let the hardware to idle
-			mmio.Mode = Z502Action;
-			mmio.Field1 = mmio.Field2 = mmio.Field3 = 0;
-			MEM_WRITE(Z502Idle, &mmio);
+			//Back here when the process has been woken up, no need to idle:
+			//with load control there may be no timer or disk event left to wait for
 			
 			break;
 		//Case of reading data from disk
@@ -1154,6 +4749,7 @@ void svc(SYSTEM_CALL_DATA *SystemCallData) {
 			break;
 		//Case of checking the status of disk
 		case SYSNUM_CHECK_DISK:
+			SyncMappedFiles((int)(long)SystemCallData->Argument[0]);
 			if (b != (long)test45&&b != (long)test46)//In these tests.errors may occur
 			{
 				for (int i = 0; i < 8; i++)
@@ -1183,6 +4779,7 @@ void svc(SYSTEM_CALL_DATA *SystemCallData) {
 			*(long *)SystemCallData->Argument[1] = mmio.Field4;
 			break;
 		//Case of creating a process
+		case SYSNUM_FORK_PROCESS:
 		case SYSNUM_CREATE_PROCESS:
 			if (PID == 14)
 			{
@@ -1194,19 +4791,24 @@ void svc(SYSTEM_CALL_DATA *SystemCallData) {
 				//Invalid priority
 				*(long *)SystemCallData->Argument[4] = ERR_BAD_PARAM;
 			}
+			else if (SystemCallData->SystemCallNumber == SYSNUM_FORK_PROCESS
+				&& !ForkSwapFits(getCurrentPID()))
+			{
+				//No swap slot is left for the child's copies of the pages in the swap cache
+				*(long *)SystemCallData->Argument[4] = ERR_BAD_PARAM;
+			}
 			else {
 				int q;
 				int flag = 0;
-				pname = (char *)malloc(sizeof(char)*20);
 				strcpy(pname, (char *)SystemCallData->Argument[0]);//Get the name of the new process
 				//Check if there are duplicate names with the new name
 				for (q = 0; q < PID; q++)
 				{
 					if (q != 0)
 					{
-						if (strcmp(pname, Blocks[q].name) == 0)
+						if (Blocks[q].status != 0 && strcmp(pname, Blocks[q].name) == 0)
 						{
-							//Find the duplicate names
+							//Find the duplicate names, the name of a terminated process is free again
 							flag = 1;
 							*(long *)SystemCallData->Argument[4] = ERR_BAD_PARAM;
 							break;
@@ -1218,7 +4820,7 @@ void svc(SYSTEM_CALL_DATA *SystemCallData) {
 					//printf("PID: %d\n",PID);
 
 					//Initial a new context
-					short *PageTable = (short*)calloc(2, NUMBER_VIRTUAL_PAGES);
+					short **PageTable = NewPageTable();
 					mmio.Mode = Z502InitializeContext;
 					mmio.Field1 = 0;
 					mmio.Field2 = (long)SystemCallData->Argument[1];
@@ -1232,14 +4834,29 @@ void svc(SYSTEM_CALL_DATA *SystemCallData) {
 					P.Context = mmio.Field1;
 					P.status = 1;//Haven't been terminated
 					*(long *)SystemCallData->Argument[3] = PID;
-					P.name =pname;
+					strcpy(P.name, pname);
 					P.order = (int)SystemCallData->Argument[2];
+					P.weight = PriorityToWeight(P.order);
+					P.vruntime = MinVruntime;//Start from the smallest virtual runtime
+					P.dtime = 0;
+					P.cputime = 0;
+					P.state = STATE_READY;
+					P.queue = QUEUE_NONE;
+					P.PageTable = PageTable;
+					P.quota = 0;
+					P.lastfault = 0;
+					P.memsuspend = 0;
+					P.leaves = 0;
 					Blocks[PID] = P;
+					Timestamp(PID, EVENT_CREATE);
+					PID++;//Counted before its pages are shared, a fork may wait for the disk
+					if (SystemCallData->SystemCallNumber == SYSNUM_FORK_PROCESS)
+					{
+						ForkMemory(getCurrentPID(), (int)P.pid);
+					}
 					
-					
-					InsertReadyOrder(&Blocks[PID], Blocks[PID].order);//Insert the new process into the ready queue
-					CallSchedulePrinter(0, Blocks[PID].pid);//Call the schedule printer
-					PID++;
+					MakeReady((int)P.pid);//Insert the new process into the ready queue
+					CallSchedulePrinter(0, P.pid);//Call the schedule printer
 					
 					*(long *)SystemCallData->Argument[4] = ERR_SUCCESS;
 
@@ -1253,27 +4870,24 @@ void svc(SYSTEM_CALL_DATA *SystemCallData) {
 			if ((int)SystemCallData->Argument[0] == -1)
 			{
 				//Change the priority of main process
+				//The ready queue is ordered by virtual runtime, so only the weight changes
 				Blocks[0].order = (int)SystemCallData->Argument[1];//Set the new order
-
-				//Check if the corresponding PCB is on the ready queue
-				if (ReadyExists(Blocks[0]))
-				{
-					RemoveReadyItem(Blocks[0]);//Remove the corresponding PCB
-					InsertReadyOrder(&Blocks[0], (int)SystemCallData->Argument[1]);//Add PCB with a new order
-				}
+				Blocks[0].weight = PriorityToWeight(Blocks[0].order);
+				*(long *)SystemCallData->Argument[2] = ERR_SUCCESS;
+			}
+			else if ((int)SystemCallData->Argument[0] < 0 || (int)SystemCallData->Argument[0] >= PID
+				|| Blocks[(int)SystemCallData->Argument[0]].state == STATE_TERMINATED)
+			{
+				//Invalid PID
+				*(long *)SystemCallData->Argument[2] = ERR_BAD_PARAM;
 			}
 			else
 			{
 				//Change the priority of a specific process (not main process)
 				Blocks[(int)SystemCallData->Argument[0]].order = (int)SystemCallData->Argument[1];//Set the new order
-				if (ReadyExists(Blocks[(int)SystemCallData->Argument[0]]))
-				{
-					RemoveReadyItem(Blocks[(int)SystemCallData->Argument[0]]);//Remove the corresponding PCB
-					InsertReadyOrder(&Blocks[PID], (int)SystemCallData->Argument[1]);//Add PCB with a new order
-				}
+				Blocks[(int)SystemCallData->Argument[0]].weight = PriorityToWeight(Blocks[(int)SystemCallData->Argument[0]].order);
+				*(long *)SystemCallData->Argument[2] = ERR_SUCCESS;
 			}
-			
-			*(long *)SystemCallData->Argument[2] = ERR_SUCCESS;
 			break;
 		//Case of suspending a specific process
 		case SYSNUM_SUSPEND_PROCESS:
@@ -1288,19 +4902,28 @@ void svc(SYSTEM_CALL_DATA *SystemCallData) {
 				//Invalid PID
 				*(long *)SystemCallData->Argument[1] = ERR_BAD_PARAM;
 			}
-			else if (ReadyExists(&Blocks[(int)SystemCallData->Argument[0]])|| TimerExists(&Blocks[(int)SystemCallData->Argument[0]])|| DiskExists(&Blocks[(int)SystemCallData->Argument[0]]))
+			else if (Blocks[(int)SystemCallData->Argument[0]].state == STATE_READY
+				|| Blocks[(int)SystemCallData->Argument[0]].state == STATE_TIMER_WAIT
+				|| Blocks[(int)SystemCallData->Argument[0]].state == STATE_DISK_WAIT
+				|| Blocks[(int)SystemCallData->Argument[0]].state == STATE_MSG_WAIT)
 			{
-				//The corresponding PCB exists on any of these queues, success case
-				//Remove the PCB from the queues
-				RemoveReadyItem(&Blocks[(int)SystemCallData->Argument[0]]);
-				RemoveTimerItem(&Blocks[(int)SystemCallData->Argument[0]]);
-				RemoveDiskItem(&Blocks[(int)SystemCallData->Argument[0]]);
-				//printf("\n%s has been suspended!\n", Blocks[(int)SystemCallData->Argument[0]].name);
+				//The process is ready or waiting, success case
+				struct PCB *sp = &Blocks[(int)SystemCallData->Argument[0]];
+				if (sp->state == STATE_READY)
+				{
+					RemoveReadyItem(sp);
+					sp->queue = QUEUE_SUSPEND;
+				}
+				//A waiting process stays on the timer queue, disk queue or message queue,
+				//and is kept off the ready queue when it wakes up
+				sp->state = STATE_SUSPENDED;
+				InsertSuspendTail(sp);
+				//printf("\n%s has been suspended!\n", sp->name);
 				*(long *)SystemCallData->Argument[1] = ERR_SUCCESS;
 			}
 			else
 			{
-				//The corresponding PCB doesn't exist at any of the queues, wrong case
+				//The process is running, suspended or terminated, wrong case
 				*(long *)SystemCallData->Argument[1] = ERR_BAD_PARAM;
 			}
 			break;
@@ -1317,20 +4940,57 @@ void svc(SYSTEM_CALL_DATA *SystemCallData) {
 				//Invalid PID
 				*(long *)SystemCallData->Argument[1] = ERR_BAD_PARAM;
 			}
-			else if (ReadyExists(&Blocks[(int)SystemCallData->Argument[0]])|| TimerExists(&Blocks[(int)SystemCallData->Argument[0]]) || DiskExists(&Blocks[(int)SystemCallData->Argument[0]]))
+			else if (Blocks[(int)SystemCallData->Argument[0]].state != STATE_SUSPENDED)
 			{
-				//The corresponding PCB exists on any of these queues, wrong case
+				//The process is not suspended, wrong case
 				*(long *)SystemCallData->Argument[1] = ERR_BAD_PARAM;
 			}
 			else
 			{
-				//The corresponding PCB doesn't exist at any of the queues, success case
-				//Insert the corresponding PCB to the ready queue
-				InsertReadyOrder(&Blocks[(int)SystemCallData->Argument[0]], Blocks[(int)SystemCallData->Argument[0]].order);
-				//printf("\n%s has been resumed!\n", Blocks[(int)SystemCallData->Argument[0]].name);
+				//Success case, go back to the state before suspending
+				struct PCB *rp = &Blocks[(int)SystemCallData->Argument[0]];
+				RemoveSuspendItem(rp);
+				if (rp->queue == QUEUE_TIMER)
+				{
+					rp->state = STATE_TIMER_WAIT;//Still sleeping
+				}
+				else if (rp->queue == QUEUE_DISK)
+				{
+					rp->state = STATE_DISK_WAIT;//Still waiting for the disk
+				}
+				else if (rp->queue == QUEUE_MESSAGE)
+				{
+					rp->state = STATE_MSG_WAIT;//Still waiting for a message
+				}
+				else
+				{
+					rp->state = STATE_READY;
+					MakeReady((int)SystemCallData->Argument[0]);//Insert the corresponding PCB to the ready queue
+				}
+				//printf("\n%s has been resumed!\n", rp->name);
 				*(long *)SystemCallData->Argument[1] = ERR_SUCCESS;
 			}
 			break;
+		//Case of sending a message
+		case SYSNUM_SEND_MESSAGE:
+			SendMessage(SystemCallData);
+			break;
+		//Case of receiving a message
+		case SYSNUM_RECEIVE_MESSAGE:
+			ReceiveMessage(SystemCallData);
+			break;
+		//Case of mapping a file into memory
+		case SYSNUM_MAP_FILE:
+			MapFile(SystemCallData);
+			break;
+		//Case of unmapping a file
+		case SYSNUM_UNMAP_FILE:
+			UnmapFile(SystemCallData);
+			break;
+		//Case of defining a shared area
+		case SYSNUM_DEFINE_SHARED_AREA:
+			DefineSharedArea(SystemCallData);
+			break;
 		case SYSNUM_FORMAT:
 			
 			writeBitMap(0,0);
@@ -2073,6 +5733,12 @@ int Create(int ID, char* name , int parent, int flag) {
 void DoDisk(MEMORY_MAPPED_IO mmio) {
 	
 	MEMORY_MAPPED_IO mmio2;
+	int disk = (int)mmio.Field1;
+	DiskPending[disk]++;//Counted from now, so the pager sees requests waiting for the disk too
+	mmio2.Mode = Z502ReturnValue;
+	mmio2.Field1 = mmio2.Field2 = mmio2.Field3 = mmio2.Field4 = 0;
+	MEM_READ(Z502Clock, &mmio2);
+	long issued = mmio2.Field1;
 	mmio2.Field2 = DEVICE_IN_USE;
 	while (mmio2.Field2 != DEVICE_FREE) {
 		mmio2.Mode = Z502Status;
@@ -2100,9 +5766,12 @@ void DoDisk(MEMORY_MAPPED_IO mmio) {
 		if (Blocks[writecount].Context == mmio2.Field1)
 		{
 			
+			Timestamp(writecount, EVENT_DISKWAIT);
+			Blocks[writecount].state = STATE_DISK_WAIT;
+			Blocks[writecount].queue = QUEUE_DISK;
+			Blocks[writecount].diskid = mmio.Field1;//Set before it is in the queue, the interrupt looks for it
 			InsertDiskOrder(&Blocks[writecount], Blocks[writecount].order);//Insert the corresponding PCB to disk queue
 
-			Blocks[writecount].diskid = mmio.Field1;
 			//InsertDiskTail(&Blocks[writecount]);
 
 			break;
@@ -2111,6 +5780,13 @@ void DoDisk(MEMORY_MAPPED_IO mmio) {
 
 	CallSchedulePrinter(4, Blocks[writecount].pid);//Call the schedule printer
 	dispatcher();//Call the dispatcher
+
+	mmio2.Mode = Z502ReturnValue;
+	mmio2.Field1 = mmio2.Field2 = mmio2.Field3 = mmio2.Field4 = 0;
+	MEM_READ(Z502Clock, &mmio2);
+	DiskTime[disk] += mmio2.Field1 - issued;
+	DiskRequests[disk]++;
+	DiskPending[disk]--;
 	
 	//Let the hardware to idle
 	/*mmio2.Mode = Z502Action;
@@ -2130,10 +5806,12 @@ void DoDisk(MEMORY_MAPPED_IO mmio) {
  ************************************************************************/
 
 void osInit(int argc, char *argv[]) {
-	short *PageTable = (short *) calloc(2, NUMBER_VIRTUAL_PAGES);
+	short **PageTable = NewPageTable();
 	INT32 i;
 	MEMORY_MAPPED_IO mmio;
 
+	initMemoryTables();
+
 	// Demonstrates how calling arguments are passed thru to here
 
 	aprintf("Program called with %d arguments:", argc);
@@ -2165,6 +5843,70 @@ void osInit(int argc, char *argv[]) {
 				"Add an 'M' to the command line to invoke multiprocessor operation.\n\n");
 	}
 
+	// Optional switches after the test name:
+	// "latency" prints the latency report at halt, "csv" also writes latency.csv
+	// "fifo" or "clock" chooses the page replacement policy (clock by default)
+	// "nopageout" turns off the pageout daemon
+	// "prefetch=N" reads N pages on each side of a swapped page (0 turns it off)
+	// "nopff" turns off the fault frequency quotas and the load control
+	// "zcache" or "zcache=N" keeps up to N swapped pages compressed in memory before disk
+	// "swapdisks=N" stripes the swap area over N disks (1 to 8)
+	// "faultcsv" writes the time of each part of every page fault to faults.csv
+	// "mpdelta" makes the memory printer print only the physical pages which changed
+	for (i = 2; i < argc; i++) {
+		if (strcmp(argv[i], "latency") == 0) {
+			latencyprint = FULL;
+		}
+		if (strcmp(argv[i], "csv") == 0) {
+			latencyprint = FULL;
+			latencycsv = 1;
+		}
+		if (strcmp(argv[i], "fifo") == 0) {
+			ReplacePolicy = POLICY_FIFO;
+		}
+		if (strcmp(argv[i], "clock") == 0) {
+			ReplacePolicy = POLICY_CLOCK;
+		}
+		if (strcmp(argv[i], "nopageout") == 0) {
+			PageoutEnabled = 0;
+		}
+		if (strcmp(argv[i], "nopff") == 0) {
+			PFFEnabled = 0;
+		}
+		if (strncmp(argv[i], "prefetch=", 9) == 0) {
+			PrefetchWindow = atoi(argv[i] + 9);
+		}
+		if (strcmp(argv[i], "zcache") == 0) {
+			ZCacheSize = ZCACHE_ENTRIES;
+		}
+		if (strncmp(argv[i], "zcache=", 7) == 0) {
+			ZCacheSize = atoi(argv[i] + 7);
+			if (ZCacheSize < 0 || ZCacheSize > ZCACHE_MAX) {
+				ZCacheSize = ZCACHE_ENTRIES;
+			}
+		}
+		if (strcmp(argv[i], "mpdelta") == 0) {
+			MPDeltaMode = 1;
+		}
+		if (strcmp(argv[i], "faultcsv") == 0) {
+			FaultTrace = fopen("faults.csv", "w");
+			if (FaultTrace != NULL) {
+				fprintf(FaultTrace, "time,pid,name,page,kind,select,swapout,swapin,update,total\n");
+			}
+		}
+		if (strncmp(argv[i], "swapdisks=", 10) == 0) {
+			SwapDiskCount = atoi(argv[i] + 10);
+			if (SwapDiskCount < 1 || SwapDiskCount > MAX_NUMBER_OF_DISKS) {
+				SwapDiskCount = SWAP_DISKS;
+			}
+		}
+	}
+
+	//The free pages and the swap area are set up before any fault, so faults
+	//on several processors at once find them ready
+	initFrames();
+	initSwap();
+
 	//          Setup so handlers will come to code in base.c
 
 	TO_VECTOR[TO_VECTOR_INT_HANDLER_ADDR ] = (void *) InterruptHandler;
@@ -2190,31 +5932,39 @@ void osInit(int argc, char *argv[]) {
 		b = (long)test3;
 		svcprint = interrprint = INITIAL;
 		scheduleprint = FULL;
+		latencyprint = FULL;
 	}
 	if (strcmp(argv[1], "test4") == 0) {
 		b = (long)test4;
 		svcprint = interrprint = INITIAL;
 		scheduleprint = FULL;
+		latencyprint = FULL;
+		cfsprint = FULL;
 	}
 	if (strcmp(argv[1], "test5") == 0) {
 		b = (long)test5;
 		svcprint = interrprint = INITIAL;
 		scheduleprint = FULL;
+		latencyprint = FULL;
 	}
 	if (strcmp(argv[1], "test6") == 0) {
 		b = (long)test6;
 		svcprint = interrprint = INITIAL;
 		scheduleprint = FULL;
+		latencyprint = FULL;
 	}
 	if (strcmp(argv[1], "test7") == 0) {
 		b = (long)test7;
 		svcprint = interrprint = INITIAL;
 		scheduleprint = FULL;
+		latencyprint = FULL;
+		cfsprint = FULL;
 	}
 	if (strcmp(argv[1], "test8") == 0) {
 		b = (long)test8;
 		svcprint = interrprint = INITIAL;
 		scheduleprint = FULL;
+		latencyprint = FULL;
 	}
 	if (strcmp(argv[1], "test9") == 0) {
 		b = (long)test9;
@@ -2326,18 +6076,72 @@ void osInit(int argc, char *argv[]) {
 		memoryprint = LIMITED;
 	}
 
-	//Initial the three queues
+	if (strcmp(argv[1], "test48") == 0) {
+		b = (long)test48;
+		svcprint = interrprint = faultprint = INITIAL;
+		memoryprint = LIMITED;
+	}
+
+	if (strcmp(argv[1], "test49") == 0) {
+		b = (long)test49;
+		svcprint = interrprint = INITIAL;
+		scheduleprint = INITIAL;
+	}
+
+	if (strcmp(argv[1], "test50") == 0) {
+		b = (long)test50;
+		svcprint = interrprint = faultprint = INITIAL;
+	}
+
+	if (strcmp(argv[1], "test51") == 0) {
+		b = (long)test51;
+		svcprint = interrprint = faultprint = INITIAL;
+	}
+	if (strcmp(argv[1], "test52") == 0) {
+		b = (long)test52;
+		svcprint = interrprint = faultprint = INITIAL;
+	}
+	if (strcmp(argv[1], "test53") == 0) {
+		b = (long)test53;
+		svcprint = interrprint = faultprint = INITIAL;
+	}
+
+	//Initial the queues
 	InitialReady();
 	InitialTimer();
 	InitialDisk();
+	InitialSuspend();
+	InitialMessage();
+	initMessages();
+	for (i = 0; i < MAX_SHARED_AREAS; i++) {
+		SharedAreas[i].used = 0;
+	}
+	for (i = 0; i < 14 * MAX_SHARED_AREAS; i++) {
+		SharedMappings[i / MAX_SHARED_AREAS][i % MAX_SHARED_AREAS].area = -1;
+	}
+	for (i = 0; i < 14 * MAX_FILE_MAPPINGS; i++) {
+		FileMappings[i / MAX_FILE_MAPPINGS][i % MAX_FILE_MAPPINGS].inode = -1;
+	}
 
 	//Build the PCB of main process and add it to the PCB list
 	struct PCB P;
 	P.pid = 0;
-	P.name = "Test";
+	strcpy(P.name, "Test");
 	P.order = 10;
 	P.status = 1;
+	P.weight = PriorityToWeight(P.order);
+	P.vruntime = 0;
+	P.dtime = 0;
+	P.cputime = 0;
+	P.state = STATE_RUNNING;
+	P.queue = QUEUE_NONE;
+	P.PageTable = PageTable;
+	P.quota = 0;
+	P.lastfault = 0;
+	P.memsuspend = 0;
+	P.leaves = 0;
 	Blocks[0] = P;
+	Timestamp(0, EVENT_CREATE);
 	
 
 	//Initial a context
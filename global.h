@@ -66,12 +66,34 @@ typedef         int                             BOOL;
   These parameters define the memory structure and page table
   mechanism.
 ***************************************************************************/
+// The memory sizes are chosen when the hardware starts up.  They
+// default to the values below and can be changed without recompiling
+// by setting the environment variables Z502_PHYSICAL_PAGES,
+// Z502_VIRTUAL_PAGES and Z502_PAGE_SIZE.  Tables that must be sized at
+// compile time use the MAX_ values.
+#define    DEFAULT_PHYSICAL_PAGES           64
+#define    DEFAULT_VIRTUAL_PAGES            1024
+#define    DEFAULT_PGSIZE                   16
+// A page table entry holds 12 bits of frame number, and a virtual
+// page number must fit in an INT16
+#define    MAX_PHYSICAL_PAGES               4096
+#define    MAX_VIRTUAL_PAGES                16384
+// The page size is a power of 2 and a multiple of the sector size
+#define    MAX_PGSIZE                       256
+extern INT32 Z502PhysicalPages;
+extern INT32 Z502VirtualPages;
+extern INT32 Z502PageSize;
 // How many physical pages of memory exist in the Z502
-#define    NUMBER_PHYSICAL_PAGES           (short)64
+#define    NUMBER_PHYSICAL_PAGES           (short)Z502PhysicalPages
 // How many virtual pages of memory exist in the Z502
-#define    NUMBER_VIRTUAL_PAGES             1024
+#define    NUMBER_VIRTUAL_PAGES             Z502VirtualPages
 // The number of bytes in a page
-#define    PGSIZE                           (short)16
+#define    PGSIZE                           (short)Z502PageSize
+// The page table has two levels. A context holds a directory of
+// PTBL_DIRECTORY_ENTRIES pointers, each to a leaf of PTBL_LEAF_PAGES
+// entries, or NULL while no page in the range of the leaf is set up.
+#define    PTBL_LEAF_PAGES                  32
+#define    PTBL_DIRECTORY_ENTRIES           ((NUMBER_VIRTUAL_PAGES + PTBL_LEAF_PAGES - 1) / PTBL_LEAF_PAGES)
 
 /***************************************************************************
      Meaning of locations in a page table entry
@@ -82,6 +104,7 @@ typedef         int                             BOOL;
 #define         PTBL_VALID_BIT                  0x8000
 #define         PTBL_MODIFIED_BIT               0x4000
 #define         PTBL_REFERENCED_BIT             0x2000
+#define         PTBL_READ_ONLY_BIT              0x1000
 #define         PTBL_PHYS_PG_NO                 0x0FFF
 
 //     These are the memory mapped IO Functions
@@ -112,6 +135,7 @@ typedef         int                             BOOL;
 #define      Z502GetCurrentContext        12
 #define      Z502SetProcessorNumber       13
 #define      Z502GetProcessorNumber       14
+#define      Z502InvalidateTLB            15
 
 // This is the memory Mapped IO Data Structure.  It is an integral
 // part of all Mapped IO.  It's required that this be filled in by
@@ -133,6 +157,9 @@ typedef struct  {
 //  number of sectors on each disk
 #define         MAX_NUMBER_OF_DISKS             (short)8
 #define         NUMBER_LOGICAL_SECTORS          (short)2048
+//  The number of bytes in a sector, a page on the swap area takes
+//  PGSIZE / DISK_SECTOR_SIZE sectors
+#define         DISK_SECTOR_SIZE                (short)16
 #define         MAX_NUMBER_INODES               (short)31
 
 /*****************************************************************
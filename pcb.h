@@ -0,0 +1,47 @@
+/*********************************************************************
+pcb.h
+
+     This include file holds the process control block shared by
+     base.c and the queue modules, so that every file sees the same
+     layout of a PCB.
+*********************************************************************/
+#ifndef  PCB_H
+#define  PCB_H
+
+#include     "global.h"
+
+//Structure of a single PCB
+struct PCB {
+	long Context;//Context of the process
+	long pid;//Process ID of the process
+	char name[20];//Name of the process, kept after it ends for the reports
+	long order;//Priority of the process
+	int ptime;//Wake-up time of the process
+	int status;//Used for checking whether this process has been terminated or not
+	           //(when status=0, it means that this process have been terminated)
+	int diskid;//Used for storing disk id when doing some disk operations
+	int cdid;//Current did
+	int csector;//Current sector
+	int Memory[MAX_PHYSICAL_PAGES];//Related logical addresses
+	long vruntime;//Weighted virtual runtime, used as the key of the ready queue
+	int weight;//Weight of the process, calculated from its priority
+	int dtime;//Time of the last dispatch of the process
+	long cputime;//CPU time used by the process
+	int ctime;//Time of creation
+	int rtime;//Time of entering the ready queue
+	int wtime;//Time of starting to wait on the timer queue or disk queue
+	int waitkind;//What the process is waiting for (EVENT_SLEEP or EVENT_DISKWAIT)
+	int etime;//Time of termination
+	int state;//State of the process (STATE_READY, STATE_RUNNING, ...)
+	int queue;//The queue this process is on (QUEUE_READY, QUEUE_TIMER, ...)
+	void *qnode;//Node holding the process on the timer, disk or message queue (NULL when on none)
+	void *snode;//Node holding the process on the suspend queue (NULL when not suspended)
+	int msgsource;//The sender a process waiting for a message wants (-1 means anyone)
+	short **PageTable;//Page directory of the process, see PageEntry
+	int quota;//Number of physical pages the process may keep, set from its fault rate (0 before its first fault)
+	long lastfault;//CPU time of the process at its last page fault
+	int memsuspend;//Set when the process is suspended because memory is overcommitted
+	int leaves;//Number of page table leaves allocated for the process
+};
+
+#endif /* PCB_H */
@@ -42,8 +42,11 @@ short   MPPrintLine( MP_INPUT_DATA * );
 int  QCreate(char *QNameDescriptor);
 int  QInsert(int QID, unsigned int QueueOrder, void *EnqueueingStructure);
 int  QInsertOnTail(int QID, void *EnqueueingStructure);
+void *QInsertNode(int QID, unsigned int QueueOrder, void *EnqueueingStructure);
+void *QInsertOnTailNode(int QID, void *EnqueueingStructure);
 void *QRemoveHead(int QID);
 void *QRemoveItem(int QID, void *EnqueueingStructure);
+void *QRemoveNode(int QID, void *Node);
 void *QNextItemInfo(int QID);
 void *QItemExists(int QID, void *EnqueueingStructure);
 char *QGetName( int QID);
@@ -88,6 +91,11 @@ void   test45( void );
 void   test46( void );
 void   test47( void );
 void   test48( void );
+void   test49( void );
+void   test50( void );
+void   test51( void );
+void   test52( void );
+void   test53( void );
 
 void   GetSkewedRandomNumber( long*, long );   // Used by sample.c
 
@@ -102,9 +110,13 @@ void   Z502CreateUserThread( void *);
 void   SoftwareTrap(SYSTEM_CALL_DATA *SystemCallData);
 void   Z502MemoryRead(INT32, INT32 * );
 void   Z502MemoryWrite(INT32, INT32 * );
+void   Z502MemoryReadBlock(INT32, char *, INT32 );
+void   Z502MemoryWriteBlock(INT32, char *, INT32 );
 void   Z502ReadPhysicalMemory( INT32, char *);
 void   Z502WritePhysicalMemory( INT32, char *);
 void   *Z502PrepareProcessForExecution( void );
 void   Z502MemoryReadModify( INT32, INT32, INT32, INT32 * );
+void   GetProcessTimeUsage( unsigned long long *, unsigned long long *,
+		unsigned long long * );               // Used by test50 and test51
 
 #endif // PROTOS_H_
@@ -73,10 +73,10 @@ void SampleCode(void) {
 	short *PAGE_TBL_ADDR;
 
 	INT32 disk_id, sector; /* Used for disk requests */
-	char disk_buffer_write[PGSIZE ];
-	char disk_buffer_read[PGSIZE ];
-	char physical_memory_write[PGSIZE ];
-	char physical_memory_read[PGSIZE ];
+	char disk_buffer_write[DISK_SECTOR_SIZE ];
+	char disk_buffer_read[DISK_SECTOR_SIZE ];
+	char physical_memory_write[MAX_PGSIZE ];
+	char physical_memory_read[MAX_PGSIZE ];
 
 	short random_buckets[NUM_RAND_BUCKETS];
 	INT32 LockResult;
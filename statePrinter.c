@@ -52,6 +52,8 @@
 #define         DO_UNLOCK                   0
 #define         SUSPEND_UNTIL_LOCKED        TRUE
 #define         DO_NOT_SUSPEND              FALSE
+// The memory table has a column for each of this many frames
+#define         MP_PRINTED_FRAMES           64
 
 // Counters for the number of times these routines are called.
 int NumberOfSPPrintLineCalls = 0;
@@ -257,12 +259,12 @@ short MPPrintLine(MP_INPUT_DATA *Input) {
 	INT32 Temporary;
 	//INT32 LockResult;
 	char temp[120];
-	char output_line3[NUMBER_PHYSICAL_PAGES + 5];
-	char output_line4[NUMBER_PHYSICAL_PAGES + 5];
-	char output_line5[NUMBER_PHYSICAL_PAGES + 5];
-	char output_line6[NUMBER_PHYSICAL_PAGES + 5];
-	char output_line7[NUMBER_PHYSICAL_PAGES + 5];
-	char output_line8[NUMBER_PHYSICAL_PAGES + 5];
+	char output_line3[MP_PRINTED_FRAMES + 5];
+	char output_line4[MP_PRINTED_FRAMES + 5];
+	char output_line5[MP_PRINTED_FRAMES + 5];
+	char output_line6[MP_PRINTED_FRAMES + 5];
+	char output_line7[MP_PRINTED_FRAMES + 5];
+	char output_line8[MP_PRINTED_FRAMES + 5];
 
 	//READ_MODIFY(MEMORY_INTERLOCK_BASE + MP_USER_LOCK, DO_LOCK, SUSPEND_UNTIL_LOCKED,
 	//			&LockResult);
@@ -293,7 +295,9 @@ short MPPrintLine(MP_INPUT_DATA *Input) {
 
 // Here we take the input data and arrange it artfully for our output
 
-	for (index = 0; index < NUMBER_PHYSICAL_PAGES ; index++) {
+	// The table has room for the first MP_PRINTED_FRAMES frames only
+	for (index = 0; index < NUMBER_PHYSICAL_PAGES && index < MP_PRINTED_FRAMES;
+			index++) {
 		if (Input->frames[index].InUse == TRUE) {
 			output_line3[index] = (char) (Input->frames[index].Pid + 48);
 			Temporary = Input->frames[index].LogicalPage;
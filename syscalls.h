@@ -60,6 +60,11 @@
 #define         SYSNUM_DIR_CONTENTS                    25
 #define         SYSNUM_DELETE_DIR                      26
 #define         SYSNUM_DELETE_FILE                     27
+#define         SYSNUM_MEM_READ_BLOCK                  28
+#define         SYSNUM_MEM_WRITE_BLOCK                 29
+#define         SYSNUM_FORK_PROCESS                    30
+#define         SYSNUM_MAP_FILE                        31
+#define         SYSNUM_UNMAP_FILE                      32
 
 // This structure defines the format used for all system calls.
 // For each call, the structure is filled in and then its address
@@ -105,6 +110,12 @@ extern int BaseThread();
 
 #define    MEM_WRITE( arg1, arg2 )   Z502MemoryWrite( arg1, (INT32 *)arg2 )
 
+#define    MEM_READ_BLOCK( arg1, arg2, arg3 )                                  \
+	         Z502MemoryReadBlock( arg1, (char *)arg2, arg3 )
+
+#define    MEM_WRITE_BLOCK( arg1, arg2, arg3 )                                 \
+	         Z502MemoryWriteBlock( arg1, (char *)arg2, arg3 )
+
 #define    READ_MODIFY( arg1, arg2, arg3, arg4 )                               \
 	         Z502MemoryReadModify( arg1, arg2, arg3, arg4 )
 
@@ -148,6 +159,24 @@ extern int BaseThread();
                 }                                                              \
 
 
+// Same arguments as CREATE_PROCESS; the new process starts with the
+// pages of the caller, shared copy-on-write.
+#define         FORK_PROCESS( arg1, arg2, arg3, arg4, arg5 )   {               \
+                SYSTEM_CALL_DATA *SystemCallData =                             \
+                     (SYSTEM_CALL_DATA *)calloc(1, sizeof (SYSTEM_CALL_DATA)); \
+                SystemCallData->NumberOfArguments = 6;                         \
+                SystemCallData->SystemCallNumber = SYSNUM_FORK_PROCESS;        \
+                SystemCallData->Argument[0] = (long *)arg1;                    \
+                SystemCallData->Argument[1] = (long *)arg2;                    \
+                SystemCallData->Argument[2] = (long *)arg3;                    \
+                SystemCallData->Argument[3] = (long *)arg4;                    \
+                SystemCallData->Argument[4] = (long *)arg5;                    \
+                ChargeTimeAndCheckEvents( COST_OF_SOFTWARE_TRAP );             \
+                SoftwareTrap(SystemCallData);                                  \
+                free(SystemCallData);                                          \
+                }                                                              \
+
+
 #define         GET_PROCESS_ID( arg1, arg2, arg3)   {                          \
                 SYSTEM_CALL_DATA *SystemCallData =                             \
                      (SYSTEM_CALL_DATA *)calloc(1, sizeof (SYSTEM_CALL_DATA)); \
@@ -437,6 +466,34 @@ extern int BaseThread();
                 free(SystemCallData);                                         \
                 }
 
+// Maps the blocks of an opened file at a page aligned logical address;
+// the pages are read from the file on first use and written back by
+// UNMAP_FILE (given the same address) or CHECK_DISK.
+#define         MAP_FILE( arg1, arg2, arg3 )      {                           \
+                SYSTEM_CALL_DATA *SystemCallData =                            \
+                     (SYSTEM_CALL_DATA *)calloc(1, sizeof(SYSTEM_CALL_DATA)); \
+                SystemCallData->NumberOfArguments = 4;                        \
+                SystemCallData->SystemCallNumber = SYSNUM_MAP_FILE;           \
+                SystemCallData->Argument[0] = (long *)arg1;                   \
+                SystemCallData->Argument[1] = (long *)(long)arg2;             \
+                SystemCallData->Argument[2] = (long *)arg3;                   \
+                ChargeTimeAndCheckEvents( COST_OF_SOFTWARE_TRAP );            \
+                SoftwareTrap(SystemCallData);                                 \
+                free(SystemCallData);                                         \
+                }
+
+#define         UNMAP_FILE( arg1, arg2 )      {                               \
+                SYSTEM_CALL_DATA *SystemCallData =                            \
+                     (SYSTEM_CALL_DATA *)calloc(1, sizeof(SYSTEM_CALL_DATA)); \
+                SystemCallData->NumberOfArguments = 3;                        \
+                SystemCallData->SystemCallNumber = SYSNUM_UNMAP_FILE;         \
+                SystemCallData->Argument[0] = (long *)(long)arg1;             \
+                SystemCallData->Argument[1] = (long *)arg2;                   \
+                ChargeTimeAndCheckEvents( COST_OF_SOFTWARE_TRAP );            \
+                SoftwareTrap(SystemCallData);                                 \
+                free(SystemCallData);                                         \
+                }
+
 /*      This section includes items needed in the scheduler printer.
  It's also useful for those routines that want to communicate
  with the scheduler printer.                                       */
@@ -483,6 +540,6 @@ typedef struct {
 #define   FRAME_REFERENCED 1
 
 typedef struct {
-	MP_FRAME_DATA  frames[NUMBER_PHYSICAL_PAGES];
+	MP_FRAME_DATA  frames[MAX_PHYSICAL_PAGES];
 } MP_INPUT_DATA;
 #endif
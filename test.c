@@ -64,7 +64,15 @@ void testD(void);
 void testS(void);
 void testX(void);
 void testZ(void);
-
+void testP(void);
+void testC(void);
+void testF(void);
+void testG(void);
+
+long RunChildren(char *Name, void (*Routine[])(void), long Routines,
+		long Count, long Fork, void *Go, long GoLength, long *ChildID,
+		unsigned long long *WallClock);
+long Test49_Partner(long *ChildID, long OurProcessID);
 void ErrorExpected(INT32, char[]);
 void SuccessExpected(INT32, char[]);
 void GetSkewedRandomNumber(long *, long);
@@ -162,8 +170,8 @@ void test2(void) {
 // This structure is used throughout this code to format the data written
 // to the disk.
 typedef union {
-	char char_data[PGSIZE ];
-	UINT32 int_data[PGSIZE / sizeof(int)];
+	char char_data[DISK_SECTOR_SIZE ];
+	UINT32 int_data[DISK_SECTOR_SIZE / sizeof(int)];
 } DISK_DATA;
 
 void test3(void) {
@@ -899,8 +907,8 @@ void test23(void) {
 	long DiskID;           // Disk ID we want to format and check
 	long ErrorReturned;
 	long Inode;
-	char WriteBuffer[PGSIZE ];
-	char ReadBuffer[PGSIZE ];
+	char WriteBuffer[DISK_SECTOR_SIZE ];
+	char ReadBuffer[DISK_SECTOR_SIZE ];
 	int ErrorFound;
 	int Index, Index2;
 
@@ -920,7 +928,7 @@ void test23(void) {
 	// Write a series of blocks to the file
 	for (Index = 0; Index < 7; Index++) {
 		WriteBuffer[0] = 42;
-		for (Index2 = 1; Index2 < PGSIZE ; Index2++) {
+		for (Index2 = 1; Index2 < DISK_SECTOR_SIZE ; Index2++) {
 			WriteBuffer[Index2] = Index;
 		}
 		WRITE_FILE(Inode, (long )Index, &WriteBuffer, &ErrorReturned);
@@ -933,12 +941,12 @@ void test23(void) {
 	// Read a series of blocks from the file
 	for (Index = 0; Index < 7; Index++) {
 		WriteBuffer[0] = 42;
-		for (Index2 = 1; Index2 < PGSIZE ; Index2++) {
+		for (Index2 = 1; Index2 < DISK_SECTOR_SIZE ; Index2++) {
 			WriteBuffer[Index2] = Index;
 		}
 		READ_FILE(Inode, (long )Index, &ReadBuffer, &ErrorReturned);
 		ErrorFound = FALSE;
-		for (Index2 = 0; Index2 < PGSIZE ; Index2++) {
+		for (Index2 = 0; Index2 < DISK_SECTOR_SIZE ; Index2++) {
 			if (ReadBuffer[Index2] != WriteBuffer[Index2])
 				ErrorFound = TRUE;
 		}
@@ -980,8 +988,8 @@ void test24(void) {
 	long SleepTime = 1000;      // How long between checks for child
 	long Inode;
 	long DiskID;
-	char WriteBuffer[PGSIZE ];
-	char ReadBuffer[PGSIZE ];
+	char WriteBuffer[DISK_SECTOR_SIZE ];
+	char ReadBuffer[DISK_SECTOR_SIZE ];
 	int ErrorFound;
 	int Index, Index2;
 
@@ -1011,12 +1019,12 @@ void test24(void) {
 
 	for (Index = 0; Index < 7; Index++) {
 		WriteBuffer[0] = 42;
-		for (Index2 = 1; Index2 < PGSIZE ; Index2++) {
+		for (Index2 = 1; Index2 < DISK_SECTOR_SIZE ; Index2++) {
 			WriteBuffer[Index2] = Index;
 		}
 		READ_FILE(Inode, (long )Index, &ReadBuffer, &ErrorReturned);
 		ErrorFound = FALSE;
-		for (Index2 = 0; Index2 < PGSIZE ; Index2++) {
+		for (Index2 = 0; Index2 < DISK_SECTOR_SIZE ; Index2++) {
 			if (ReadBuffer[Index2] != WriteBuffer[Index2])
 				ErrorFound = TRUE;
 		}
@@ -1363,7 +1371,7 @@ void testZ(void) {
 		// Write a series of blocks to the file
 		for (Index = 0; Index < 7; Index++) {
 			WriteBuffer[0] = OurProcessID % TEST25_CHILDREN;
-			for (Index2 = 1; Index2 < PGSIZE ; Index2++) {
+			for (Index2 = 1; Index2 < DISK_SECTOR_SIZE ; Index2++) {
 				WriteBuffer[Index2] = Index;
 			}
 			WRITE_FILE(Inode, (long )Index, &WriteBuffer, &ErrorReturned);
@@ -1376,13 +1384,13 @@ void testZ(void) {
 		// Read a series of blocks from the file
 		for (Index = 0; Index < 7; Index++) {
 			WriteBuffer[0] = OurProcessID % TEST25_CHILDREN;
-			for (Index2 = 1; Index2 < PGSIZE ; Index2++) {
+			for (Index2 = 1; Index2 < DISK_SECTOR_SIZE ; Index2++) {
 				WriteBuffer[Index2] = Index;
 			}
 			READ_FILE(Inode, (long )Index, &ReadBuffer, &ErrorReturned);
 			SuccessExpected(ErrorReturned, "READ_FILE");
 			ErrorReturned = FALSE;
-			for (Index2 = 0; Index2 < PGSIZE ; Index2++) {
+			for (Index2 = 0; Index2 < DISK_SECTOR_SIZE ; Index2++) {
 				if (ReadBuffer[Index2] != WriteBuffer[Index2])
 					ErrorReturned = TRUE;
 			}
@@ -1907,6 +1915,654 @@ void test48(void) {
 
 }                                  // End of test48
 
+/**************************************************************************
+ RunChildren - the harness shared by test49, test51 and test52.
+
+ Starts Count children named Name_0, Name_1, ... with CREATE_PROCESS,
+ or with FORK_PROCESS when Fork is TRUE.  Child i runs
+ Routine[i % Routines] and its PID is put in ChildID[i].  When all of
+ them are started, each is sent the GoLength bytes at Go (which may be
+ ChildID itself), then RunChildren waits until every child has sent a
+ message back to say it is done.
+ Returns the time from the first go until the last child is done.  The
+ host (wall clock) time of the same span, in us, is put in *WallClock
+ when WallClock isn't NULL.
+ **************************************************************************/
+long RunChildren(char *Name, void (*Routine[])(void), long Routines,
+		long Count, long Fork, void *Go, long GoLength, long *ChildID,
+		unsigned long long *WallClock) {
+	long ErrorReturned;
+	long StartTime;
+	long EndTime;
+	long SendLength;
+	long SenderPid;
+	long Iteration;
+	unsigned long long UserTime, SystemTime, StartWallClock, EndWallClock;
+	char ProcessName[32];
+	char Buffer[8];
+
+	for (Iteration = 0; Iteration < Count; Iteration++) {
+		sprintf(ProcessName, "%s_%ld", Name, Iteration);
+		if (Fork) {
+			FORK_PROCESS(ProcessName, Routine[Iteration % Routines], 10,
+					&ChildID[Iteration], &ErrorReturned);
+			SuccessExpected(ErrorReturned, "FORK_PROCESS");
+		} else {
+			CREATE_PROCESS(ProcessName, Routine[Iteration % Routines], 10,
+					&ChildID[Iteration], &ErrorReturned);
+			SuccessExpected(ErrorReturned, "CREATE_PROCESS");
+		}
+	}
+
+	GET_TIME_OF_DAY(&StartTime);
+	GetProcessTimeUsage(&UserTime, &SystemTime, &StartWallClock);
+	for (Iteration = 0; Iteration < Count; Iteration++) {
+		SEND_MESSAGE(ChildID[Iteration], Go, GoLength, &ErrorReturned);
+		SuccessExpected(ErrorReturned, "SEND_MESSAGE");
+	}
+	// Wait until every child says it is done
+	for (Iteration = 0; Iteration < Count; Iteration++) {
+		RECEIVE_MESSAGE(-1, Buffer, sizeof(Buffer), &SendLength, &SenderPid,
+				&ErrorReturned);
+		SuccessExpected(ErrorReturned, "RECEIVE_MESSAGE");
+	}
+	GET_TIME_OF_DAY(&EndTime);
+	GetProcessTimeUsage(&UserTime, &SystemTime, &EndWallClock);
+
+	if (WallClock != NULL)
+		*WallClock = EndWallClock - StartWallClock;
+	return (EndTime - StartTime);
+}                                  // End of RunChildren
+
+/**************************************************************************
+ Test49 measures the throughput of SEND_MESSAGE / RECEIVE_MESSAGE.
+
+ It starts NUMBER_TEST49_PAIRS producer/consumer pairs with RunChildren,
+ a consumer and then its producer, and sends every one of them the PIDs
+ of all of them, so each knows its partner.  Every producer sends
+ NUMBER_TEST49_MESSAGES messages to its consumer.  The mailboxes are
+ bounded, so the consumer sends an acknowledgement after every
+ TEST49_WINDOW messages and the producer waits for it before going on.
+ When all are done test49 prints the number of messages per 1000 time
+ units.
+ **************************************************************************/
+
+#define           NUMBER_TEST49_PAIRS                           4
+#define           NUMBER_TEST49_MESSAGES                      200
+#define           TEST49_MESSAGE_LENGTH                        16
+#define           TEST49_WINDOW                                 4
+
+void test49(void) {
+	long OurProcessID;     // PID of test49
+	long ErrorReturned;    // Used as part of system calls
+	long ChildID[2 * NUMBER_TEST49_PAIRS];
+	long Elapsed;
+	void (*Routine[])(void) = { testC, testP };
+
+	GET_PROCESS_ID("", &OurProcessID, &ErrorReturned);
+	aprintf("\n\nRelease %s:Test 49: Pid %ld\n", CURRENT_REL, OurProcessID);
+
+	Elapsed = RunChildren("Pair49", Routine, 2, 2 * NUMBER_TEST49_PAIRS,
+			FALSE, ChildID, sizeof(ChildID), ChildID, NULL);
+
+	aprintf("TEST49: %d pairs sent %d messages in %ld time units",
+			NUMBER_TEST49_PAIRS,
+			NUMBER_TEST49_PAIRS * NUMBER_TEST49_MESSAGES, Elapsed);
+	if (Elapsed > 0)
+		aprintf(", %.1f messages per 1000 time units\n",
+				1000.0 * NUMBER_TEST49_PAIRS * NUMBER_TEST49_MESSAGES
+						/ Elapsed);
+	else
+		aprintf("\n");
+	TERMINATE_PROCESS(-2, &ErrorReturned);
+
+}                                  // End of test49
+
+/**************************************************************************
+ Test49_Partner - used by testP and testC.
+ Finds the caller in the PIDs sent by test49 and returns the PID of the
+ other process of its pair (a consumer is followed by its producer).
+ **************************************************************************/
+long Test49_Partner(long *ChildID, long OurProcessID) {
+	int Index;
+
+	for (Index = 0; Index < 2 * NUMBER_TEST49_PAIRS; Index++) {
+		if (ChildID[Index] == OurProcessID)
+			return (ChildID[Index ^ 1]);
+	}
+	aprintf("ERROR: Test49 process %ld isn't in the list of pairs\n",
+			OurProcessID);
+	return (-1);
+}                                  // End of Test49_Partner
+
+/**************************************************************************
+ TestP - the producer of test49.
+ Finds its consumer in the PIDs sent by test49, then sends it
+ NUMBER_TEST49_MESSAGES numbered messages, waiting for an
+ acknowledgement after every TEST49_WINDOW messages.
+ **************************************************************************/
+void testP(void) {
+	long OurProcessID;
+	long ErrorReturned;
+	long TargetPid;
+	long SendLength;
+	long SenderPid;
+	long ChildID[2 * NUMBER_TEST49_PAIRS];
+	int Index;
+	char Buffer[TEST49_MESSAGE_LENGTH];
+
+	GET_PROCESS_ID("", &OurProcessID, &ErrorReturned);
+	RECEIVE_MESSAGE(0, ChildID, sizeof(ChildID), &SendLength, &SenderPid,
+			&ErrorReturned);
+	SuccessExpected(ErrorReturned, "RECEIVE_MESSAGE");
+	TargetPid = Test49_Partner(ChildID, OurProcessID);
+
+	for (Index = 0; Index < NUMBER_TEST49_MESSAGES; Index++) {
+		sprintf(Buffer, "%d", Index);
+		SEND_MESSAGE(TargetPid, Buffer, (strlen(Buffer) + 1), &ErrorReturned);
+		if (ErrorReturned != ERR_SUCCESS)
+			aprintf("ERROR: Producer %ld got error %ld from SEND_MESSAGE\n",
+					OurProcessID, ErrorReturned);
+		if ((Index + 1) % TEST49_WINDOW == 0) {
+			// Wait until the consumer has emptied its mailbox
+			RECEIVE_MESSAGE(TargetPid, Buffer, TEST49_MESSAGE_LENGTH,
+					&SendLength, &SenderPid, &ErrorReturned);
+		}
+	}
+	aprintf("Producer %ld sent %d messages to %ld\n", OurProcessID,
+			NUMBER_TEST49_MESSAGES, TargetPid);
+	SEND_MESSAGE(0, "done", 5, &ErrorReturned);
+	SuccessExpected(ErrorReturned, "SEND_MESSAGE");
+	TERMINATE_PROCESS(-1, &ErrorReturned);
+	aprintf("ERROR: TestP should be terminated but isn't.\n");
+}                                  // End of testP
+
+/**************************************************************************
+ TestC - the consumer of test49.
+ Finds its producer in the PIDs sent by test49, then receives
+ NUMBER_TEST49_MESSAGES messages from it and checks they come in order.
+ An acknowledgement goes back after every TEST49_WINDOW messages.
+ **************************************************************************/
+void testC(void) {
+	long OurProcessID;
+	long ErrorReturned;
+	long SourcePid;
+	long SendLength;
+	long SenderPid;
+	long ChildID[2 * NUMBER_TEST49_PAIRS];
+	int Index;
+	char Buffer[TEST49_MESSAGE_LENGTH];
+
+	GET_PROCESS_ID("", &OurProcessID, &ErrorReturned);
+	RECEIVE_MESSAGE(0, ChildID, sizeof(ChildID), &SendLength, &SenderPid,
+			&ErrorReturned);
+	SuccessExpected(ErrorReturned, "RECEIVE_MESSAGE");
+	SourcePid = Test49_Partner(ChildID, OurProcessID);
+
+	for (Index = 0; Index < NUMBER_TEST49_MESSAGES; Index++) {
+		RECEIVE_MESSAGE(SourcePid, Buffer, TEST49_MESSAGE_LENGTH, &SendLength,
+				&SenderPid, &ErrorReturned);
+		if (ErrorReturned != ERR_SUCCESS)
+			aprintf("ERROR: Consumer %ld got error %ld from RECEIVE_MESSAGE\n",
+					OurProcessID, ErrorReturned);
+		else if (atoi(Buffer) != Index || SenderPid != SourcePid)
+			aprintf("ERROR: Consumer %ld expected message %d from %ld, got %s from %ld\n",
+					OurProcessID, Index, SourcePid, Buffer, SenderPid);
+		if ((Index + 1) % TEST49_WINDOW == 0) {
+			SEND_MESSAGE(SourcePid, "ack", 4, &ErrorReturned);
+		}
+	}
+	SEND_MESSAGE(0, "done", 5, &ErrorReturned);
+	SuccessExpected(ErrorReturned, "SEND_MESSAGE");
+	TERMINATE_PROCESS(-1, &ErrorReturned);
+	aprintf("ERROR: TestC should be terminated but isn't.\n");
+}                                  // End of testC
+
+/**************************************************************************
+ Test50 is a microbenchmark of Z502MemoryRead / Z502MemoryWrite.
+
+ It touches NUMBER_TEST50_PAGES pages so they are resident, then makes
+ NUMBER_TEST50_ACCESSES reads and writes at three offsets in the page:
+ an aligned word, an unaligned word inside the page and a word that
+ straddles two pages.  For each it checks the data and prints the
+ number of calls per host (wall clock) second.
+
+ Then it moves the same number of bytes with Z502MemoryWriteBlock /
+ Z502MemoryReadBlock.  The first block goes over pages which aren't
+ resident yet, so its page faults are taken in the middle of the range.
+ **************************************************************************/
+
+#define           NUMBER_TEST50_PAGES                           8
+#define           NUMBER_TEST50_ACCESSES                    50000
+#define           TEST50_BLOCK_BYTES        (NUMBER_TEST50_PAGES * PGSIZE)
+#define           TEST50_BLOCK_START        (4 * NUMBER_TEST50_PAGES * PGSIZE + 3)
+
+void test50(void) {
+	long OurProcessID;
+	long ErrorReturned;
+	long MemoryAddress;
+	long Index;
+	INT32 DataWritten;
+	INT32 DataRead;
+	int Kind;
+	unsigned long long UserTime, SystemTime, StartWallClock, EndWallClock;
+	long Offsets[3] = { 4, 1, PGSIZE - 2 };
+	char *KindNames[3] = { "aligned", "unaligned", "straddling" };
+	char Block[TEST50_BLOCK_BYTES];
+	char Check[TEST50_BLOCK_BYTES];
+
+	GET_PROCESS_ID("", &OurProcessID, &ErrorReturned);
+	aprintf("\n\nRelease %s:Test 50: Pid %ld\n", CURRENT_REL, OurProcessID);
+
+	// Bring the pages in before timing anything
+	for (Index = 0; Index <= NUMBER_TEST50_PAGES; Index++) {
+		DataWritten = 0;
+		MEM_WRITE(Index * PGSIZE, &DataWritten);
+	}
+
+	for (Kind = 0; Kind < 3; Kind++) {
+		GetProcessTimeUsage(&UserTime, &SystemTime, &StartWallClock);
+		for (Index = 0; Index < NUMBER_TEST50_ACCESSES; Index++) {
+			MemoryAddress = (Index % NUMBER_TEST50_PAGES) * PGSIZE
+					+ Offsets[Kind];
+			DataWritten = (INT32) (Index + OurProcessID);
+			MEM_WRITE(MemoryAddress, &DataWritten);
+			MEM_READ(MemoryAddress, &DataRead);
+			if (DataRead != DataWritten) {
+				aprintf("ERROR: Test50 %s address %ld wrote %d read %d\n",
+						KindNames[Kind], MemoryAddress, DataWritten, DataRead);
+				break;
+			}
+		}
+		GetProcessTimeUsage(&UserTime, &SystemTime, &EndWallClock);
+		aprintf("TEST50: %-10s %d calls in %llu us",
+				KindNames[Kind], 2 * NUMBER_TEST50_ACCESSES,
+				EndWallClock - StartWallClock);
+		if (EndWallClock > StartWallClock)
+			aprintf(", %.0f calls/sec\n",
+					1E6 * 2 * NUMBER_TEST50_ACCESSES
+							/ (double) (EndWallClock - StartWallClock));
+		else
+			aprintf("\n");
+	}
+
+	for (Index = 0; Index < TEST50_BLOCK_BYTES; Index++)
+		Block[Index] = (char) (Index + OurProcessID);
+	GetProcessTimeUsage(&UserTime, &SystemTime, &StartWallClock);
+	for (Index = 0; Index < 4 * NUMBER_TEST50_ACCESSES / TEST50_BLOCK_BYTES;
+			Index++) {
+		Block[0] = (char) Index;
+		MEM_WRITE_BLOCK(TEST50_BLOCK_START, Block, TEST50_BLOCK_BYTES);
+		MEM_READ_BLOCK(TEST50_BLOCK_START, Check, TEST50_BLOCK_BYTES);
+		if (memcmp(Block, Check, TEST50_BLOCK_BYTES) != 0) {
+			aprintf("ERROR: Test50 block at %d read back different data\n",
+					TEST50_BLOCK_START);
+			break;
+		}
+	}
+	GetProcessTimeUsage(&UserTime, &SystemTime, &EndWallClock);
+	aprintf("TEST50: %-10s %ld calls of %d bytes in %llu us", "block",
+			2 * Index, TEST50_BLOCK_BYTES, EndWallClock - StartWallClock);
+	if (EndWallClock > StartWallClock)
+		aprintf(", %.0f bytes/sec\n",
+				1E6 * 2 * Index * TEST50_BLOCK_BYTES
+						/ (double) (EndWallClock - StartWallClock));
+	else
+		aprintf("\n");
+	TERMINATE_PROCESS(-2, &ErrorReturned);
+
+}                                  // End of test50
+
+/**************************************************************************
+ Test51 measures the page fault throughput of several processes.
+
+ It starts NUMBER_TEST51_PROCESSES copies of testF, each touching its
+ own TEST51_PAGES pages, so together they need twice the physical
+ memory and keep faulting.  Every TEST51_BURST accesses a copy sleeps
+ shortly, so the copies take turns.  All the copies are started at once, and the
+ time from the start until the last one is done is printed both in
+ simulated time and in host (wall clock) time.  Run it with the
+ argument M to let the faults of the copies go on different processors;
+ the OS prints the number of page faults at the end.
+ **************************************************************************/
+
+#define           NUMBER_TEST51_PROCESSES                       4
+#define           NUMBER_TEST51_ACCESSES                      400
+#define           TEST51_BURST                                 20
+#define           TEST51_PAUSE                                 10
+#define           TEST51_PAGES  (2 * NUMBER_PHYSICAL_PAGES / NUMBER_TEST51_PROCESSES)
+
+void test51(void) {
+	long OurProcessID;
+	long ErrorReturned;
+	long ChildID[NUMBER_TEST51_PROCESSES];
+	long Elapsed;
+	unsigned long long WallClock;
+	void (*Routine[])(void) = { testF };
+
+	GET_PROCESS_ID("", &OurProcessID, &ErrorReturned);
+	aprintf("\n\nRelease %s:Test 51: Pid %ld\n", CURRENT_REL, OurProcessID);
+
+	Elapsed = RunChildren("Fault51", Routine, 1, NUMBER_TEST51_PROCESSES,
+			FALSE, "go", 3, ChildID, &WallClock);
+
+	aprintf("TEST51: %d processes made %d accesses over %d pages each\n",
+			NUMBER_TEST51_PROCESSES, 2 * NUMBER_TEST51_ACCESSES, TEST51_PAGES);
+	aprintf("TEST51: %ld time units, %llu us", Elapsed, WallClock);
+	if (WallClock > 0)
+		aprintf(", %.0f accesses/sec\n",
+				1E6 * 2 * NUMBER_TEST51_ACCESSES * NUMBER_TEST51_PROCESSES
+						/ (double) WallClock);
+	else
+		aprintf("\n");
+	TERMINATE_PROCESS(-2, &ErrorReturned);
+
+}                                  // End of test51
+
+/**************************************************************************
+ TestF - a process of test51.
+ Waits for the go from test51, then writes and reads back its pages in
+ a scattered order.  At the end every page it wrote is checked once
+ more, since it may have been to swap and back in the meantime.
+ **************************************************************************/
+void testF(void) {
+	long OurProcessID;
+	long ErrorReturned;
+	long SendLength;
+	long SenderPid;
+	long Index;
+	long PageNumber;
+	long MemoryAddress;
+	INT32 DataWritten;
+	INT32 DataRead;
+	char *Touched;
+	char Buffer[8];
+
+	GET_PROCESS_ID("", &OurProcessID, &ErrorReturned);
+	Touched = (char *) calloc(TEST51_PAGES, sizeof(char));
+	RECEIVE_MESSAGE(0, Buffer, sizeof(Buffer), &SendLength, &SenderPid,
+			&ErrorReturned);
+	SuccessExpected(ErrorReturned, "RECEIVE_MESSAGE");
+
+	for (Index = 0; Index < NUMBER_TEST51_ACCESSES; Index++) {
+		PageNumber = (Index * 37 + OurProcessID * 11) % TEST51_PAGES;
+		MemoryAddress = PageNumber * PGSIZE;
+		DataWritten = (INT32) (MemoryAddress + OurProcessID);
+		MEM_WRITE(MemoryAddress, &DataWritten);
+		MEM_READ(MemoryAddress, &DataRead);
+		if (DataRead != DataWritten)
+			aprintf("ERROR: TestF %ld address %ld wrote %d read %d\n",
+					OurProcessID, MemoryAddress, DataWritten, DataRead);
+		Touched[PageNumber] = 1;
+		// Let the other copies run, so their pages compete for memory
+		if (Index % TEST51_BURST == TEST51_BURST - 1)
+			SLEEP(TEST51_PAUSE);
+	}
+	for (PageNumber = 0; PageNumber < TEST51_PAGES; PageNumber++) {
+		if (Touched[PageNumber] == 0)
+			continue;
+		MemoryAddress = PageNumber * PGSIZE;
+		MEM_READ(MemoryAddress, &DataRead);
+		if (DataRead != (INT32) (MemoryAddress + OurProcessID))
+			aprintf("ERROR: TestF %ld address %ld lost its data, read %d\n",
+					OurProcessID, MemoryAddress, DataRead);
+	}
+	free(Touched);
+	SEND_MESSAGE(0, "done", 5, &ErrorReturned);
+	SuccessExpected(ErrorReturned, "SEND_MESSAGE");
+	TERMINATE_PROCESS(-1, &ErrorReturned);
+	aprintf("ERROR: TestF should be terminated but isn't.\n");
+}                                  // End of testF
+
+/**************************************************************************
+ Test52 measures the start up of a family of similar processes.
+
+ The parent fills TEST52_PAGES pages with a table, then starts
+ NUMBER_TEST52_PROCESSES copies of testG twice: first with
+ CREATE_PROCESS, so every copy has to write the table itself, then with
+ FORK_PROCESS, so every copy starts with the pages of the parent shared
+ copy-on-write.  Every copy checks the whole table, changes a few of its
+ pages and tells the parent it is done.  The time from the first create
+ until the last copy is done is printed for both rounds.  At the end the
+ parent checks that the copies didn't change its own table.
+ **************************************************************************/
+
+#define           NUMBER_TEST52_PROCESSES                       4
+#define           TEST52_PAGES          (NUMBER_PHYSICAL_PAGES / 2)
+#define           TEST52_CHANGED                                4
+#define           TEST52_DATA( address )    ((INT32) (address) * 3 + 52)
+
+void test52(void) {
+	long OurProcessID;
+	long ErrorReturned;
+	long ChildID[NUMBER_TEST52_PROCESSES];
+	long StartTime;
+	long EndTime;
+	long Round;
+	long Iteration;
+	long MemoryAddress;
+	INT32 DataWritten;
+	INT32 DataRead;
+	char *Go;
+	void (*Routine[])(void) = { testG };
+
+	GET_PROCESS_ID("", &OurProcessID, &ErrorReturned);
+	aprintf("\n\nRelease %s:Test 52: Pid %ld\n", CURRENT_REL, OurProcessID);
+
+	for (Iteration = 0; Iteration < TEST52_PAGES; Iteration++) {
+		MemoryAddress = Iteration * PGSIZE;
+		DataWritten = TEST52_DATA(MemoryAddress);
+		MEM_WRITE(MemoryAddress, &DataWritten);
+	}
+
+	for (Round = 0; Round < 2; Round++) {
+		// The time of the starts is measured too
+		GET_TIME_OF_DAY(&StartTime);
+		Go = (Round == 0) ? "build" : "forked";
+		RunChildren(Round == 0 ? "Create52" : "Fork52", Routine, 1,
+				NUMBER_TEST52_PROCESSES, Round != 0, Go, (strlen(Go) + 1),
+				ChildID, NULL);
+		GET_TIME_OF_DAY(&EndTime);
+		aprintf("TEST52: %s: %d processes started with %d pages in %ld time units\n",
+				Round == 0 ? "CREATE_PROCESS" : "FORK_PROCESS",
+				NUMBER_TEST52_PROCESSES, TEST52_PAGES, EndTime - StartTime);
+	}
+
+	for (Iteration = 0; Iteration < TEST52_PAGES; Iteration++) {
+		MemoryAddress = Iteration * PGSIZE;
+		MEM_READ(MemoryAddress, &DataRead);
+		if (DataRead != TEST52_DATA(MemoryAddress))
+			aprintf("ERROR: Test52 address %ld was changed to %d\n",
+					MemoryAddress, DataRead);
+	}
+	TERMINATE_PROCESS(-2, &ErrorReturned);
+
+}                                  // End of test52
+
+/**************************************************************************
+ TestG - a process of test52.
+ Writes the table of test52 when it was created by CREATE_PROCESS,
+ then checks every page of it and changes TEST52_CHANGED of them.
+ **************************************************************************/
+void testG(void) {
+	long OurProcessID;
+	long ErrorReturned;
+	long SendLength;
+	long SenderPid;
+	long Index;
+	long MemoryAddress;
+	INT32 DataWritten;
+	INT32 DataRead;
+	char Buffer[8];
+
+	GET_PROCESS_ID("", &OurProcessID, &ErrorReturned);
+	RECEIVE_MESSAGE(0, Buffer, sizeof(Buffer), &SendLength, &SenderPid,
+			&ErrorReturned);
+	SuccessExpected(ErrorReturned, "RECEIVE_MESSAGE");
+
+	if (strcmp(Buffer, "build") == 0) {
+		for (Index = 0; Index < TEST52_PAGES; Index++) {
+			MemoryAddress = Index * PGSIZE;
+			DataWritten = TEST52_DATA(MemoryAddress);
+			MEM_WRITE(MemoryAddress, &DataWritten);
+		}
+	}
+	for (Index = 0; Index < TEST52_PAGES; Index++) {
+		MemoryAddress = Index * PGSIZE;
+		MEM_READ(MemoryAddress, &DataRead);
+		if (DataRead != TEST52_DATA(MemoryAddress))
+			aprintf("ERROR: TestG %ld address %ld read %d\n", OurProcessID,
+					MemoryAddress, DataRead);
+	}
+	for (Index = 0; Index < TEST52_CHANGED; Index++) {
+		MemoryAddress = ((Index * 7 + OurProcessID) % TEST52_PAGES) * PGSIZE;
+		DataWritten = TEST52_DATA(MemoryAddress) + (INT32) OurProcessID;
+		MEM_WRITE(MemoryAddress, &DataWritten);
+		MEM_READ(MemoryAddress, &DataRead);
+		if (DataRead != DataWritten)
+			aprintf("ERROR: TestG %ld address %ld wrote %d read %d\n",
+					OurProcessID, MemoryAddress, DataWritten, DataRead);
+	}
+	SEND_MESSAGE(0, "done", 5, &ErrorReturned);
+	SuccessExpected(ErrorReturned, "SEND_MESSAGE");
+	TERMINATE_PROCESS(-1, &ErrorReturned);
+	aprintf("ERROR: TestG should be terminated but isn't.\n");
+}                                  // End of testG
+
+/**************************************************************************
+ Test53 compares reading a file with READ_FILE and through MAP_FILE.
+
+ TEST53_WRITTEN blocks of a new file are written with WRITE_FILE, then
+ they are read twice: with a READ_FILE for each block, and with MEM_READ
+ of every word of the file mapped at TEST53_ADDRESS, which needs no
+ system call at all.  The time of both scans is printed.  Then blocks
+ are changed through the mapping: one is written back by CHECK_DISK
+ while the file stays mapped, the others by UNMAP_FILE, one of them a
+ block which had never been written.  READ_FILE checks all of them.
+ **************************************************************************/
+
+#define           TEST53_BLOCKS                                 8
+#define           TEST53_WRITTEN                                6
+#define           TEST53_ADDRESS                  ((long)PGSIZE * 8)
+#define           TEST53_DATA( block, byte )  ((char) ((block) * 16 + (byte) + 53))
+
+void test53(void) {
+	long OurProcessID;
+	long DiskID;
+	long ErrorReturned;
+	long Inode;
+	long StartTime;
+	long EndTime;
+	char Buffer[DISK_SECTOR_SIZE];
+	char Expected[TEST53_BLOCKS][DISK_SECTOR_SIZE];
+	INT32 DataRead;
+	INT32 DataWritten;
+	long Block;
+	long Index;
+	long MemoryAddress;
+	long Errors = 0;
+
+	DiskID = 2;
+	GET_PROCESS_ID("", &OurProcessID, &ErrorReturned);
+	aprintf("\n\nRelease %s:Test 53: Pid %ld\n", CURRENT_REL, OurProcessID);
+
+	FORMAT(DiskID, &ErrorReturned);
+	SuccessExpected(ErrorReturned, "FORMAT");
+	OPEN_DIR(DiskID, "root", &ErrorReturned);
+	SuccessExpected(ErrorReturned, "OPEN_DIR of root");
+	OPEN_FILE("Test53", &Inode, &ErrorReturned);
+	SuccessExpected(ErrorReturned, "OPEN_FILE");
+
+	for (Block = 0; Block < TEST53_BLOCKS; Block++) {
+		for (Index = 0; Index < DISK_SECTOR_SIZE; Index++)
+			Expected[Block][Index] =
+					(Block < TEST53_WRITTEN) ? TEST53_DATA(Block, Index) : 0;
+	}
+	for (Block = 0; Block < TEST53_WRITTEN; Block++) {
+		memcpy(Buffer, Expected[Block], DISK_SECTOR_SIZE);
+		WRITE_FILE(Inode, Block, Buffer, &ErrorReturned);
+	}
+
+	// Scan the file with one system call a block
+	GET_TIME_OF_DAY(&StartTime);
+	for (Block = 0; Block < TEST53_WRITTEN; Block++) {
+		READ_FILE(Inode, Block, Buffer, &ErrorReturned);
+		if (memcmp(Buffer, Expected[Block], DISK_SECTOR_SIZE) != 0)
+			Errors++;
+	}
+	GET_TIME_OF_DAY(&EndTime);
+	aprintf("TEST53: READ_FILE read %d blocks in %ld time units\n",
+			TEST53_WRITTEN, EndTime - StartTime);
+
+	// Scan it again through the mapping
+	MAP_FILE(Inode, TEST53_ADDRESS, &ErrorReturned);
+	SuccessExpected(ErrorReturned, "MAP_FILE");
+	GET_TIME_OF_DAY(&StartTime);
+	for (Block = 0; Block < TEST53_WRITTEN; Block++) {
+		for (Index = 0; Index < DISK_SECTOR_SIZE; Index += sizeof(INT32)) {
+			MemoryAddress = TEST53_ADDRESS + Block * DISK_SECTOR_SIZE + Index;
+			MEM_READ(MemoryAddress, &DataRead);
+			if (memcmp(&DataRead, &Expected[Block][Index], sizeof(INT32)) != 0)
+				Errors++;
+		}
+	}
+	GET_TIME_OF_DAY(&EndTime);
+	aprintf("TEST53: MAP_FILE read %d blocks in %ld time units\n",
+			TEST53_WRITTEN, EndTime - StartTime);
+	// The blocks never written read as zeros
+	for (Block = TEST53_WRITTEN; Block < TEST53_BLOCKS; Block++) {
+		MemoryAddress = TEST53_ADDRESS + Block * DISK_SECTOR_SIZE;
+		MEM_READ(MemoryAddress, &DataRead);
+		if (DataRead != 0)
+			Errors++;
+	}
+
+	// The pages are in use now, and the address must be page aligned
+	MAP_FILE(Inode, TEST53_ADDRESS, &ErrorReturned);
+	ErrorExpected(ErrorReturned, "MAP_FILE over a mapped file");
+	MAP_FILE(Inode, TEST53_ADDRESS + 1, &ErrorReturned);
+	ErrorExpected(ErrorReturned, "MAP_FILE at an unaligned address");
+
+	// Change a block and write it back while the file stays mapped
+	DataWritten = 0x53535353;
+	memcpy(&Expected[1][0], &DataWritten, sizeof(INT32));
+	MEM_WRITE(TEST53_ADDRESS + 1 * DISK_SECTOR_SIZE, &DataWritten);
+	CHECK_DISK(DiskID, &ErrorReturned);
+	SuccessExpected(ErrorReturned, "CHECK_DISK");
+	READ_FILE(Inode, 1, Buffer, &ErrorReturned);
+	if (memcmp(Buffer, Expected[1], DISK_SECTOR_SIZE) != 0)
+		Errors++;
+
+	// Change a written block and a block which never was, then unmap
+	DataWritten = 0x35353535;
+	memcpy(&Expected[2][4], &DataWritten, sizeof(INT32));
+	MEM_WRITE(TEST53_ADDRESS + 2 * DISK_SECTOR_SIZE + 4, &DataWritten);
+	memcpy(&Expected[TEST53_BLOCKS - 1][8], &DataWritten, sizeof(INT32));
+	MEM_WRITE(TEST53_ADDRESS + (TEST53_BLOCKS - 1) * DISK_SECTOR_SIZE + 8,
+			&DataWritten);
+	UNMAP_FILE(TEST53_ADDRESS, &ErrorReturned);
+	SuccessExpected(ErrorReturned, "UNMAP_FILE");
+	UNMAP_FILE(TEST53_ADDRESS, &ErrorReturned);
+	ErrorExpected(ErrorReturned, "UNMAP_FILE of an unmapped address");
+
+	for (Block = 0; Block < TEST53_BLOCKS; Block++) {
+		READ_FILE(Inode, Block, Buffer, &ErrorReturned);
+		if (memcmp(Buffer, Expected[Block], DISK_SECTOR_SIZE) != 0) {
+			aprintf("ERROR: Test53 block %ld was not written back\n", Block);
+			Errors++;
+		}
+	}
+	CLOSE_FILE(Inode, &ErrorReturned);
+	CHECK_DISK(DiskID, &ErrorReturned);
+	SuccessExpected(ErrorReturned, "CHECK_DISK");
+
+	if (Errors > 0)
+		aprintf("ERROR: Test53 found %ld wrong words or blocks\n", Errors);
+	else
+		aprintf("TEST53: the file read the same both ways\n");
+	TERMINATE_PROCESS(-2, &ErrorReturned);
+}                                  // End of test53
+
 /**************************************************************************
  TestS - test shared memory usage.
  This test runs as multiple instances of processes; there are several
@@ -2011,23 +2667,23 @@ typedef struct {
                       + (long)local->StartingAddressOfSharedArea
 
 // This allows us to print out the shared memory for debugging purposes
+// The whole area is brought over with one block read
 void PrintTestSMemory(SHARED_DATA *sp, LOCAL_DATA *ld) {
 	int Index;
 	INT32 Data1, Data2, Data3, Data4, Data5;
+	SHARED_DATA Copy;
 
 	aprintf("\nNumber of Masters + Slaves = %d\n",
 			(int) NUMBER_TEST48_PROCESSES);
 
+	MEM_READ_BLOCK(MEM_ADJUST2( sp, ld, proc_info[ 0 ] ), &Copy,
+			sizeof(PROCESS_INFO) * NUMBER_TEST48_PROCESSES);
 	for (Index = 0; Index < NUMBER_TEST48_PROCESSES; Index++) {
-		MEM_READ(MEM_ADJUST2( sp, ld, proc_info[ Index ].structure_tag),
-				&Data1);
-		MEM_READ(MEM_ADJUST2( sp, ld, proc_info[ Index ].Pid ), &Data2);
-		MEM_READ(MEM_ADJUST2( sp, ld, proc_info[ Index ].MailboxToMaster ),
-				&Data3);
-		MEM_READ(MEM_ADJUST2( sp, ld, proc_info[ Index ].MailboxToSlave ),
-				&Data4);
-		MEM_READ(MEM_ADJUST2( sp, ld, proc_info[ Index ].WriterOfMailbox),
-				&Data5);
+		Data1 = Copy.proc_info[Index].structure_tag;
+		Data2 = Copy.proc_info[Index].Pid;
+		Data3 = Copy.proc_info[Index].MailboxToMaster;
+		Data4 = Copy.proc_info[Index].MailboxToSlave;
+		Data5 = Copy.proc_info[Index].WriterOfMailbox;
 
 		aprintf("Mailbox info for index %d:\n", Index);
 		aprintf("\tIndex = %d, Struct Tag = %d,  ", Index, Data1);
@@ -2047,6 +2703,7 @@ void testS(void) {
 	SHARED_DATA *shared_ptr = 0;
 	int Index;
 	INT32 ReadWriteData;    // Used to move to and from shared memory
+	INT32 SlotData[2];      // Used to initialize our slot
 
 	ld = (LOCAL_DATA *) calloc(1, sizeof(LOCAL_DATA));
 	if (ld == 0) {
@@ -2073,18 +2730,16 @@ void testS(void) {
 			&ld->ErrorReturned);              // Output - any error
 	SuccessExpected(ld->ErrorReturned, "DEFINE_SHARED_AREA");
 
-	ReadWriteData = PROC_INFO_STRUCT_TAG; // Sanity data
-	MEM_WRITE(MEM_ADJUST(proc_info[ld->OurSharedID].structure_tag),
-			&ReadWriteData);
-
-	ReadWriteData = OurProcessID; // Store PID in our slot
-	MEM_WRITE(MEM_ADJUST(proc_info[ld->OurSharedID].Pid), &ReadWriteData);
-	ReadWriteData = 0;         // Initialize this counter
-	MEM_WRITE(MEM_ADJUST(proc_info[ld->OurSharedID].MailboxToMaster),
-			&ReadWriteData);
-	ReadWriteData = 0;         // Initialize this counter
-	MEM_WRITE(MEM_ADJUST(proc_info[ld->OurSharedID].MailboxToSlave),
-			&ReadWriteData);
+	// Sanity data and our PID, then the two counters, each pair in one
+	// block write.  TerminationRequest is left to the master.
+	SlotData[0] = PROC_INFO_STRUCT_TAG;
+	SlotData[1] = (INT32) OurProcessID;
+	MEM_WRITE_BLOCK(MEM_ADJUST(proc_info[ld->OurSharedID].structure_tag),
+			SlotData, 2 * sizeof(INT32));
+	SlotData[0] = 0;
+	SlotData[1] = 0;
+	MEM_WRITE_BLOCK(MEM_ADJUST(proc_info[ld->OurSharedID].MailboxToMaster),
+			SlotData, 2 * sizeof(INT32));
 
 	//  This is the code used ONLY by the MASTER Process
 	if (ld->OurSharedID == 0) {  //   We are the MASTER Process
@@ -2232,7 +2887,7 @@ void testS(void) {
 void Test44_Statistics(int Pid, long PageNumber, int Mode) {
 	static short NotInitialized = TRUE;
 	static int Counter[MAX44_PID];
-	static int PagesTouched[MAX44_PID][NUMBER_VIRTUAL_PAGES];
+	static int PagesTouched[MAX44_PID][MAX_VIRTUAL_PAGES];
 	int i, j;
 	int PrintsSoFar = 0;
 
@@ -113,7 +113,16 @@ Z502CONTEXT *GetCurrentContext();
 int GetLock(UINT32 RequestedMutex, char *CallingRoutine);
 INT16 GetMode();
 void GetNextEventTime(INT32 *);
-UINT16 *GetPageTableAddress();
+INT32 GetMemorySize(char *Name, INT32 Default, INT32 Smallest,
+		INT32 Largest);
+UINT16 **GetPageTableAddress();
+UINT16 *GetPageTableEntry(INT32 VirtualPageNumber);
+TLB_ENTRY *TLBLookup(INT32 VirtualPageNumber);
+void TLBInsert(INT32 VirtualPageNumber, UINT16 *Entry);
+void TLBInvalidate(void *Context, INT32 VirtualPageNumber);
+UINT16 *TranslatePage(INT16 VirtualPageNumber, INT32 *phys_pg, BOOL Writing);
+void MemoryBlock(INT32 VirtualAddress, char *data_ptr, INT32 Length,
+		BOOL read_or_write);
 int GetProcessorID();
 void GetProcessTimeUsage( unsigned long long *,
 		          unsigned long long *,
@@ -136,7 +145,7 @@ void HardwareFault(INT16, INT16);
 void HardwareInternalPanic(INT32);
 void IdleSimulation();
 void MakeContext(long *ReturningContextPointer, long starting_address,
-		UINT16* PageTable, BOOL user_or_kernel);
+		UINT16** PageTable, BOOL user_or_kernel);
 void MemoryCommon(INT32, char *, BOOL);
 void PhysicalMemoryCommon(INT32, char *, BOOL);
 void MemoryMappedIO(INT32, MEMORY_MAPPED_IO *, BOOL);
@@ -149,7 +158,7 @@ int ReleaseLock(UINT32 RequestedMutex, char* CallingRoutine);
 void ResumeProcessExecution(Z502CONTEXT *Context);
 void SetCurrentContext(Z502CONTEXT *Address);
 void SetMode(INT16 mode);
-void SetPageTableAddress(UINT16 *address);
+void SetPageTableAddress(UINT16 **address);
 int SignalCondition(UINT32 Condition, char* CallingRoutine);
 void SoftwareTrap(SYSTEM_CALL_DATA *SystemCallData);
 void SuspendProcessExecution(Z502CONTEXT *Context);
@@ -170,7 +179,11 @@ void *TO_VECTOR[TO_VECTOR_TYPES ];
  *****************************************************************/
 
 // This is the definition of the physical memory supported by the hardware
-char MEMORY[NUMBER_PHYSICAL_PAGES * PGSIZE ];
+// It is allocated by Z502Init once the memory sizes are known.
+char *MEMORY;
+INT32 Z502PhysicalPages = DEFAULT_PHYSICAL_PAGES;
+INT32 Z502VirtualPages = DEFAULT_VIRTUAL_PAGES;
+INT32 Z502PageSize = DEFAULT_PGSIZE;
 
 // The hardware keeps track of the address of the context currently being run
 //Z502CONTEXT *Z502_CURRENT_CONTEXT[MAX_NUMBER_OF_PROCESSORS ];
@@ -226,6 +239,12 @@ int InterruptTid;                   // The Task ID of the interrupt thread
 // Contains info about all the threads created
 THREAD_INFO ThreadTable[MAX_THREAD_TABLE_SIZE];
 
+// The TLB of each processor, indexed like ThreadTable
+#if TLB_SETS > 0
+TLB_ENTRY TLB[MAX_THREAD_TABLE_SIZE][TLB_SETS][TLB_WAYS];
+#endif
+INT32 TLBUseCount = 0;
+
 #ifdef   WINDOWS
 HANDLE LocalEvent[100];
 #endif
@@ -241,13 +260,18 @@ int            NextMutexToAllocate = 0;
  MemoryCommon
 
  This code simulates a memory access.  Actions include:
+ o Look for the translation in the TLB of the processor.  On a miss,
+ walk the page table and load the translation into the TLB.
  o Take a page fault if any of the following occur;
  + Illegal virtual address,
  + Page table doesn't exist,
  + Address is larger than page table,
  + Page table entry exists, but page is invalid.
+ + Page is read only and this is a write.
  o The page exists in physical memory, so get the physical address.
- Be careful since it may wrap across frame boundaries.
+ An aligned word can't cross a frame boundary, it is copied with one
+ load or store.  Otherwise be careful since it may wrap across frame
+ boundaries.
  o Copy data to/from caller's location.
  o Set referenced/modified bit in page table.
  o Advance time and see if an interrupt has occurred.
@@ -256,12 +280,13 @@ int            NextMutexToAllocate = 0;
 void MemoryCommon(INT32 VirtualAddress, char *data_ptr, BOOL read_or_write) {
 	INT16 VirtualPageNumber;
 	INT32 phys_pg;
-	INT16 PhysicalAddress[4];
+	INT32 PhysicalAddress[4];
 	INT32 page_offset;
 	INT16 index;
 	INT32 ptbl_bits;
 	INT16 invalidity;
 	BOOL page_is_valid;
+	UINT16 *page_table_entry;
 	char Debug_Text[32];
 
 	strcpy(Debug_Text, "MemoryCommon");
@@ -276,45 +301,25 @@ void MemoryCommon(INT32 VirtualAddress, char *data_ptr, BOOL read_or_write) {
 			(VirtualAddress >= 0) ? VirtualAddress / PGSIZE : -1);
 	page_offset = VirtualAddress % PGSIZE;
 
-	page_is_valid = FALSE;
-
-	/*  Loop until the virtual page passes all the tests        */
+	page_table_entry = TranslatePage(VirtualPageNumber, &phys_pg,
+			read_or_write == SYSNUM_MEM_WRITE);
 
-	while (page_is_valid == FALSE ) {
-		invalidity = 0;
-		if (VirtualPageNumber >= NUMBER_VIRTUAL_PAGES)
-			invalidity = 1;
-		if (VirtualPageNumber < 0)
-			invalidity = 2;
-		if (GetPageTableAddress() == NULL)
-			invalidity = 3;
-		if ((invalidity == 0)
-				&& (GetPageTableAddress()[(UINT16) VirtualPageNumber]
-						& PTBL_VALID_BIT) == 0)
-			invalidity = 4;
-
-		DoMemoryDebug(invalidity, VirtualPageNumber);
-		if (invalidity > 0) {
-			if ((GetCurrentContext() != NULL)
-					&& ((GetCurrentContext()->StructureID)
-							!= CONTEXT_STRUCTURE_ID )) {
-				aprintf(
-						"The address of the current context is invalid in MemoryCommon\n");
-				aprintf("Something in the OS has destroyed this location.\n");
-				HardwareInternalPanic(ERR_OS502_GENERATED_BUG);
-			}
-			GetCurrentContext()->FaultInProgress = TRUE;
-			// The fault handler will do it's own locking - 11/13/11
-			ReleaseLock(HardwareLock, "MemoryCommon#3");
-			HardwareFault(INVALID_MEMORY, VirtualPageNumber);
-			// Regain the lock to protect the memory check - 11/13/11
-			GetLock(HardwareLock, "MemoryCommon#4");
-		} else
-			page_is_valid = TRUE;
-	} /* END of while         */
+	/*  Fast path for an aligned word                           */
 
-	phys_pg = GetPageTableAddress()[VirtualPageNumber] & PTBL_PHYS_PG_NO;
-	PhysicalAddress[0] = (INT16) (phys_pg * (INT32) PGSIZE + page_offset);
+	if ((page_offset & 3) == 0 && phys_pg < NUMBER_PHYSICAL_PAGES) {
+		char *word = &MEMORY[phys_pg * (INT32) PGSIZE + page_offset];
+		if (read_or_write == SYSNUM_MEM_READ) {
+			memcpy(data_ptr, word, sizeof(INT32));
+			*page_table_entry |= PTBL_REFERENCED_BIT;
+		} else {
+			memcpy(word, data_ptr, sizeof(INT32));
+			*page_table_entry |= PTBL_REFERENCED_BIT | PTBL_MODIFIED_BIT;
+		}
+		ChargeTimeAndCheckEvents(COST_OF_MEMORY_ACCESS);
+		ReleaseLock(HardwareLock, "MemoryCommon#6");
+		return;
+	}
+	PhysicalAddress[0] = phys_pg * (INT32) PGSIZE + page_offset;
 	PhysicalAddress[1] = PhysicalAddress[0] + 1; /* first guess */
 	PhysicalAddress[2] = PhysicalAddress[0] + 2; /* first guess */
 	PhysicalAddress[3] = PhysicalAddress[0] + 3; /* first guess */
@@ -326,9 +331,15 @@ void MemoryCommon(INT32 VirtualAddress, char *data_ptr, BOOL read_or_write) {
 			invalidity = 0;
 			if (VirtualPageNumber + 1 >= NUMBER_VIRTUAL_PAGES)
 				invalidity = 6;
-			if ((GetPageTableAddress()[(UINT16) VirtualPageNumber + 1]
-					& PTBL_VALID_BIT) == 0)
+			if ((invalidity == 0)
+					&& (GetPageTableEntry(VirtualPageNumber + 1) == NULL
+							|| (*GetPageTableEntry(VirtualPageNumber + 1)
+									& PTBL_VALID_BIT) == 0))
 				invalidity = 8;
+			if ((invalidity == 0) && read_or_write == SYSNUM_MEM_WRITE
+					&& (*GetPageTableEntry(VirtualPageNumber + 1)
+							& PTBL_READ_ONLY_BIT))
+				invalidity = 9;
 			DoMemoryDebug(invalidity, (short) (VirtualPageNumber + 1));
 			if (invalidity > 0) {
 				if (GetCurrentContext() != NULL
@@ -347,10 +358,10 @@ void MemoryCommon(INT32 VirtualAddress, char *data_ptr, BOOL read_or_write) {
 		} /* End of while         */
 
 		phys_pg =
-				GetPageTableAddress()[VirtualPageNumber + 1] & PTBL_PHYS_PG_NO;
+				*GetPageTableEntry(VirtualPageNumber + 1) & PTBL_PHYS_PG_NO;
 		for (index = PGSIZE - (INT16) page_offset; index <= 3; index++)
-			PhysicalAddress[index] = (INT16) ((phys_pg - 1) * (INT32) PGSIZE
-					+ page_offset + (INT32) index);
+			PhysicalAddress[index] = (phys_pg - 1) * (INT32) PGSIZE
+					+ page_offset + (INT32) index;
 	} /* End of if page       */
 
 	if (phys_pg < 0 || phys_pg > NUMBER_PHYSICAL_PAGES - 1) {
@@ -383,15 +394,237 @@ void MemoryCommon(INT32 VirtualAddress, char *data_ptr, BOOL read_or_write) {
 		ptbl_bits = PTBL_REFERENCED_BIT | PTBL_MODIFIED_BIT;
 	}
 
-	GetPageTableAddress()[VirtualPageNumber] |= ptbl_bits;
+	*page_table_entry |= ptbl_bits;
 	if (page_offset > PGSIZE - 4)
-		GetPageTableAddress()[VirtualPageNumber + 1] |= ptbl_bits;
+		*GetPageTableEntry(VirtualPageNumber + 1) |= ptbl_bits;
 
 	ChargeTimeAndCheckEvents(COST_OF_MEMORY_ACCESS);
 
 	ReleaseLock(HardwareLock, "MemoryCommon#5");
 }                      // End of MemoryCommon
 
+/*****************************************************************
+ MemoryBlock
+
+ This code simulates a copy of a range of memory.  Each page of
+ the range is translated once and copied while holding the
+ HardwareLock; a page fault in the middle of the range is taken
+ the same way as for a single word.  The time of the whole copy
+ is charged at once, as many memory accesses as the words copied.
+ *****************************************************************/
+
+void MemoryBlock(INT32 VirtualAddress, char *data_ptr, INT32 Length,
+		BOOL read_or_write) {
+	INT16 VirtualPageNumber;
+	INT32 phys_pg;
+	INT32 page_offset;
+	INT32 chunk;
+	INT32 done;
+	UINT16 *page_table_entry;
+	char *frame_ptr;
+
+	for (done = 0; done < Length; done += chunk) {
+		if (VirtualAddress + done >= 0) {
+			VirtualPageNumber = (INT16) ((VirtualAddress + done) / PGSIZE);
+			page_offset = (VirtualAddress + done) % PGSIZE;
+		} else {
+			VirtualPageNumber = -1;
+			page_offset = 0;
+		}
+		chunk = PGSIZE - page_offset;
+		if (chunk > Length - done)
+			chunk = Length - done;
+
+		GetLock(HardwareLock, "MemoryBlock#1");
+		page_table_entry = TranslatePage(VirtualPageNumber, &phys_pg,
+				read_or_write == SYSNUM_MEM_WRITE_BLOCK);
+		if (phys_pg < 0 || phys_pg > NUMBER_PHYSICAL_PAGES - 1) {
+			aprintf("The physical address is invalid in MemoryBlock\n");
+			aprintf("Physical page = %d, Virtual Page = %d\n", phys_pg,
+					VirtualPageNumber);
+			HardwareInternalPanic(ERR_OS502_GENERATED_BUG);
+		}
+		frame_ptr = &MEMORY[phys_pg * (INT32) PGSIZE + page_offset];
+		if (read_or_write == SYSNUM_MEM_READ_BLOCK) {
+			memcpy(data_ptr + done, frame_ptr, chunk);
+			*page_table_entry |= PTBL_REFERENCED_BIT;
+		} else {
+			memcpy(frame_ptr, data_ptr + done, chunk);
+			*page_table_entry |= PTBL_REFERENCED_BIT | PTBL_MODIFIED_BIT;
+		}
+		if (done + chunk == Length)
+			ChargeTimeAndCheckEvents(
+					COST_OF_MEMORY_ACCESS * ((Length + 3) / 4));
+		ReleaseLock(HardwareLock, "MemoryBlock#2");
+	}
+}                      // End of MemoryBlock
+
+/*****************************************************************
+ TranslatePage
+
+ Find the page table entry of a virtual page of the current context
+ and the physical page it maps to.  The translation comes from the
+ TLB when it is there; otherwise take page faults until the OS has
+ made the page valid, then load the translation into the TLB.
+ A write to a read only page takes a page fault as well, until the
+ OS has made the page writable.
+ Called and returns with the HardwareLock held.
+ *****************************************************************/
+
+UINT16 *TranslatePage(INT16 VirtualPageNumber, INT32 *phys_pg, BOOL Writing) {
+	TLB_ENTRY *tlb_entry;
+	UINT16 *page_table_entry;
+	INT16 invalidity;
+	BOOL page_is_valid;
+
+	tlb_entry = NULL;
+	if (VirtualPageNumber >= 0 && VirtualPageNumber < NUMBER_VIRTUAL_PAGES)
+		tlb_entry = TLBLookup(VirtualPageNumber);
+	if (tlb_entry != NULL
+			&& !(Writing && (*tlb_entry->Entry & PTBL_READ_ONLY_BIT))) {
+		*phys_pg = tlb_entry->PhysicalPage;
+		return tlb_entry->Entry;
+	}
+	page_is_valid = FALSE;
+
+	/*  Loop until the virtual page passes all the tests        */
+
+	while (page_is_valid == FALSE ) {
+		invalidity = 0;
+		if (VirtualPageNumber >= NUMBER_VIRTUAL_PAGES)
+			invalidity = 1;
+		if (VirtualPageNumber < 0)
+			invalidity = 2;
+		if (GetPageTableAddress() == NULL)
+			invalidity = 3;
+		if ((invalidity == 0)
+				&& (GetPageTableEntry(VirtualPageNumber) == NULL
+						|| (*GetPageTableEntry(VirtualPageNumber)
+								& PTBL_VALID_BIT) == 0))
+			invalidity = 4;
+		if ((invalidity == 0) && Writing
+				&& (*GetPageTableEntry(VirtualPageNumber) & PTBL_READ_ONLY_BIT))
+			invalidity = 5;
+
+		DoMemoryDebug(invalidity, VirtualPageNumber);
+		if (invalidity > 0) {
+			if ((GetCurrentContext() != NULL)
+					&& ((GetCurrentContext()->StructureID)
+							!= CONTEXT_STRUCTURE_ID )) {
+				aprintf(
+						"The address of the current context is invalid in MemoryCommon\n");
+				aprintf("Something in the OS has destroyed this location.\n");
+				HardwareInternalPanic(ERR_OS502_GENERATED_BUG);
+			}
+			GetCurrentContext()->FaultInProgress = TRUE;
+			// The fault handler will do it's own locking - 11/13/11
+			ReleaseLock(HardwareLock, "MemoryCommon#3");
+			HardwareFault(INVALID_MEMORY, VirtualPageNumber);
+			// Regain the lock to protect the memory check - 11/13/11
+			GetLock(HardwareLock, "MemoryCommon#4");
+		} else
+			page_is_valid = TRUE;
+	} /* END of while         */
+
+	page_table_entry = GetPageTableEntry(VirtualPageNumber);
+	*phys_pg = *page_table_entry & PTBL_PHYS_PG_NO;
+	TLBInsert(VirtualPageNumber, page_table_entry);
+	GetCurrentContext()->FaultInProgress = FALSE;
+	return page_table_entry;
+}                      // End of TranslatePage
+
+/*****************************************************************
+ TLBLookup
+
+ Look for the translation of a virtual page of the current context
+ in the TLB of this processor.  Returns NULL on a miss.
+ The TLB keeps the translations of every context; an entry is only
+ used by the context that loaded it, so switching contexts needs no
+ flush.
+ *****************************************************************/
+
+TLB_ENTRY *TLBLookup(INT32 VirtualPageNumber) {
+#if TLB_SETS > 0
+	TLB_ENTRY *set;
+	void *context;
+	int way;
+
+	set = TLB[GetProcessorID()][VirtualPageNumber % TLB_SETS];
+	context = (void *) GetCurrentContext();
+	for (way = 0; way < TLB_WAYS; way++) {
+		if (set[way].Valid && set[way].VirtualPage == VirtualPageNumber
+				&& set[way].Context == context) {
+			set[way].LastUse = TLBUseCount++;
+			HardwareStats.TLBHits++;
+			return &set[way];
+		}
+	}
+#endif
+	HardwareStats.TLBMisses++;
+	return NULL;
+}                      // End of TLBLookup
+
+/*****************************************************************
+ TLBInsert
+
+ Load the translation of a valid page table entry into the TLB of
+ this processor, replacing the least recently used entry of its set.
+ *****************************************************************/
+
+void TLBInsert(INT32 VirtualPageNumber, UINT16 *Entry) {
+#if TLB_SETS > 0
+	TLB_ENTRY *set;
+	int way, victim = 0;
+
+	set = TLB[GetProcessorID()][VirtualPageNumber % TLB_SETS];
+	for (way = 0; way < TLB_WAYS; way++) {
+		if (!set[way].Valid) {
+			victim = way;
+			break;
+		}
+		if (set[way].LastUse < set[victim].LastUse)
+			victim = way;
+	}
+	set[victim].Context = (void *) GetCurrentContext();
+	set[victim].Entry = Entry;
+	set[victim].VirtualPage = VirtualPageNumber;
+	set[victim].PhysicalPage = *Entry & PTBL_PHYS_PG_NO;
+	set[victim].Bits = *Entry;
+	set[victim].LastUse = TLBUseCount++;
+	set[victim].Valid = TRUE;
+#endif
+}                      // End of TLBInsert
+
+/*****************************************************************
+ TLBInvalidate
+
+ Called when the OS rewrites a page table entry.  Drops the
+ translation of the page from the TLB of every processor.  A NULL
+ Context drops the entries of every context, a VirtualPageNumber
+ of -1 every page of the context.
+ *****************************************************************/
+
+void TLBInvalidate(void *Context, INT32 VirtualPageNumber) {
+#if TLB_SETS > 0
+	int cpu, set, way;
+
+	for (cpu = 0; cpu < MAX_THREAD_TABLE_SIZE; cpu++) {
+		for (set = 0; set < TLB_SETS; set++) {
+			for (way = 0; way < TLB_WAYS; way++) {
+				TLB_ENTRY *tlb = &TLB[cpu][set][way];
+				if (tlb->Valid
+						&& (Context == NULL || tlb->Context == Context)
+						&& (VirtualPageNumber == -1
+								|| tlb->VirtualPage == VirtualPageNumber)) {
+					tlb->Valid = FALSE;
+					HardwareStats.TLBInvalidations++;
+				}
+			}
+		}
+	}
+#endif
+}                      // End of TLBInvalidate
+
 /*****************************************************************
  DoMemoryDebug
 
@@ -427,6 +660,10 @@ void DoMemoryDebug(INT16 invalidity, INT16 vpn) {
 		aprintf("\t\tYou must aim this virtual page at a physical frame\n");
 		aprintf("\t\tand mark this page table slot as valid.\n");
 	}
+	if (invalidity == 5) {
+		aprintf("You wrote to virtual page %d, which is marked\n", vpn);
+		aprintf("\t\tread only in the page table.\n");
+	}
 	if (invalidity == 6) {
 		aprintf("The address you asked for crosses onto a second page.\n");
 		aprintf("\t\tThis second page took a fault.\n");
@@ -443,6 +680,11 @@ void DoMemoryDebug(INT16 invalidity, INT16 vpn) {
 		aprintf("\t\tYou must aim this virtual page at a physical frame\n");
 		aprintf("\t\tand mark this page table slot as valid.\n");
 	}
+	if (invalidity == 9) {
+		aprintf("The address you asked for crosses onto a second page.\n");
+		aprintf("\t\tYou wrote to virtual page %d, which is marked\n", vpn);
+		aprintf("\t\tread only in the page table.\n");
+	}
 }                        // End of DoMemoryDebug
 
 /*****************************************************************
@@ -462,6 +704,25 @@ void Z502MemoryWrite(INT32 VirtualAddress, INT32 *data_ptr) {
 	MemoryCommon(VirtualAddress, (char *) data_ptr, (BOOL) SYSNUM_MEM_WRITE);
 }                  // End  Z502MemoryWrite
 
+/*************************************************************************
+ Z502MemoryReadBlock / Z502MemoryWriteBlock
+
+ Copy Length bytes between a buffer of the caller and a range of
+ virtual memory starting at VirtualAddress.
+ *************************************************************************/
+
+void Z502MemoryReadBlock(INT32 VirtualAddress, char *data_ptr, INT32 Length) {
+
+	MemoryBlock(VirtualAddress, data_ptr, Length,
+			(BOOL) SYSNUM_MEM_READ_BLOCK);
+}                  // End  Z502MemoryReadBlock
+
+void Z502MemoryWriteBlock(INT32 VirtualAddress, char *data_ptr, INT32 Length) {
+
+	MemoryBlock(VirtualAddress, data_ptr, Length,
+			(BOOL) SYSNUM_MEM_WRITE_BLOCK);
+}                  // End  Z502MemoryWriteBlock
+
 /*************************************************************************
  Z502MemoryReadModify
 
@@ -682,7 +943,7 @@ void MemoryMappedIO(INT32 address, MEMORY_MAPPED_IO *mmio, BOOL ReadOrWrite) {
 		}  // End of Mode === StartContext
 
 		if (mmio->Mode == Z502InitializeContext) {
-			MakeContext(&LongTemporary, mmio->Field2, (UINT16 *) mmio->Field3,
+			MakeContext(&LongTemporary, mmio->Field2, (UINT16 **) mmio->Field3,
 			KERNEL_MODE);
 			mmio->Field1 = LongTemporary;    // Context pointer
 			mmio->Field4 = ERR_SUCCESS;      // Error code
@@ -702,6 +963,13 @@ void MemoryMappedIO(INT32 address, MEMORY_MAPPED_IO *mmio, BOOL ReadOrWrite) {
 			break;
 		}    // End of Mode == Z502GetCurrentContext
 
+		// Field1 is the context (0 for all), Field2 the page (-1 for all)
+		if (mmio->Mode == Z502InvalidateTLB) {
+			TLBInvalidate((void *) mmio->Field1, (INT32) mmio->Field2);
+			mmio->Field4 = ERR_SUCCESS;      // Error code
+			break;
+		}    // End of Mode == Z502InvalidateTLB
+
 		mmio->Field4 = ERR_BAD_PARAM;    // Couldn't handle the mode
 		if (DO_DEVICE_DEBUG) {
 			aprintf("- BEGIN DO_DEVICE DEBUG - Z502Context - \n");
@@ -758,7 +1026,7 @@ void MemoryMappedIO(INT32 address, MEMORY_MAPPED_IO *mmio, BOOL ReadOrWrite) {
 
 void PhysicalMemoryCommon(INT32 PhysicalPageNumber, char *data_ptr,
 		BOOL read_or_write) {
-	INT16 PhysicalPageAddress;
+	INT32 PhysicalPageAddress;
 	INT16 index;
 	char Debug_Text[32];
 
@@ -1002,7 +1270,7 @@ void HardwareCheckDisk(int DiskID) {
 	int Result;
 	INT32 local_error;
 	char *BufferPointer;
-	unsigned char LocalBuffer[PGSIZE ];
+	unsigned char LocalBuffer[DISK_SECTOR_SIZE ];
 	char OutputString[120];
 	char TempString[16];
 
@@ -1011,17 +1279,17 @@ void HardwareCheckDisk(int DiskID) {
 		//	HardwareReadDisk(DiskID, Index, &BufferPointer);
 		GetSectorStructure(DiskID, Index, &BufferPointer, &local_error);
 		if (local_error == 0) {      // it's a good sector
-			memcpy(LocalBuffer, BufferPointer, PGSIZE);
+			memcpy(LocalBuffer, BufferPointer, DISK_SECTOR_SIZE);
 			// Determine if the Sector contains all zeros.  If so, don't print.
 			Result = 0;
-			for (Index2 = 0; Index2 < PGSIZE ; Index2++) {
+			for (Index2 = 0; Index2 < DISK_SECTOR_SIZE ; Index2++) {
 				Result += LocalBuffer[Index2];
 			}
 			if (Result > 0) {
 				sprintf(TempString, "%04X ", Index);
 				TempString[5] = '\0';
 				memcpy(OutputString, TempString, 6);
-				for (Index2 = 0; Index2 < PGSIZE ; Index2++) {
+				for (Index2 = 0; Index2 < DISK_SECTOR_SIZE ; Index2++) {
 					sprintf(TempString, "%02X ", LocalBuffer[Index2]);
 					strncat(OutputString, TempString, 3);
 				}
@@ -1235,9 +1503,9 @@ void IdleSimulation(void) {
  *****************************************************************/
 
 void MakeContext(long *ReturningContextPointer, long starting_address,
-		UINT16* PageTable, BOOL user_or_kernel) {
+		UINT16** PageTable, BOOL user_or_kernel) {
 	Z502CONTEXT *our_ptr;
-	int Temporary;
+	UINT16 *Temporary;
 
 	if (Z502Initialized == FALSE) {
 		Z502Init();
@@ -1257,11 +1525,12 @@ void MakeContext(long *ReturningContextPointer, long starting_address,
 	}
 
 	// Our goal here is to save the OS developer some pain later on.
-	// We assume that the page table handed to us is valid, and that it
-	// has a length of VIRTUAL_MEM_PAGES.  Check that we can touch this
+	// We assume that the page directory handed to us is valid, and that it
+	// has a length of PTBL_DIRECTORY_ENTRIES.  Check that we can touch this
 	// much memory.  If not, then we will crash here rather than later.
-	Temporary = PageTable[0];
-	PageTable[NUMBER_VIRTUAL_PAGES - 1] = Temporary;
+	// The leaves are allocated by the OS as it needs them.
+	Temporary = PageTable[PTBL_DIRECTORY_ENTRIES - 1];
+	PageTable[PTBL_DIRECTORY_ENTRIES - 1] = Temporary;
 	// Well, if we get here, then the OS correctly allocated memory.
 
 	our_ptr->StructureID = CONTEXT_STRUCTURE_ID;
@@ -1474,8 +1743,10 @@ void SwitchContext(void **IncomingContextPointer, BOOL DoStartSuspend) {
  *       associated with caller.
  * SetCurrentContext()  When a processor is started, place the
  *       context that's being run in a place we can find it.
- * GetPageTableAddress() - Function returns address of Page Table
+ * GetPageTableAddress() - Function returns address of Page Directory
  *       in use by the caller.
+ * GetPageTableEntry() - Function walks the page directory of the
+ *       caller to the entry of a virtual page.
  ****************************************************************/
 //
 // Finds which processor is being run for the process that makes this call
@@ -1513,15 +1784,26 @@ void SetCurrentContext(Z502CONTEXT *Address) {
 	ThreadTable[GetProcessorID()].Context = Address;
 }     // End of SetCurrentContext
 
-// Return the Page Table of the  process that's
+// Return the Page Directory of the  process that's
 //   currently running on the processor of the caller
-UINT16 *GetPageTableAddress() {
+UINT16 **GetPageTableAddress() {
 	return ThreadTable[GetProcessorID()].Context->PageTablePointer;
 }    // End of  GetPageTableAddress()
 
-// Sets the Page Table of the  process that's
+// Return the address of the page table entry of a virtual page of
+//   the process that's currently running on the processor of the caller.
+//   NULL means the leaf holding it hasn't been allocated by the OS.
+UINT16 *GetPageTableEntry(INT32 VirtualPageNumber) {
+	UINT16 *Leaf;
+	Leaf = GetPageTableAddress()[VirtualPageNumber / PTBL_LEAF_PAGES];
+	if (Leaf == NULL)
+		return NULL;
+	return &Leaf[VirtualPageNumber % PTBL_LEAF_PAGES];
+}    // End of  GetPageTableEntry()
+
+// Sets the Page Directory of the  process that's
 //   currently running on the processor of the caller
-void SetPageTableAddress(UINT16 *address) {
+void SetPageTableAddress(UINT16 **address) {
 	ThreadTable[GetProcessorID()].Context->PageTablePointer = address;
 }    // End of  SetPageTableAddress()
 
@@ -1644,7 +1926,7 @@ void HardwareInterrupt(void) {
 
 			//  We MAYBE should be clearing all these as well - and not just the current one.
 			memcpy(DiskState[event_type - DISK_INTERRUPT ].Destination, // Bugfix 07/2014
-					DiskState[event_type - DISK_INTERRUPT ].Source, PGSIZE);
+					DiskState[event_type - DISK_INTERRUPT ].Source, DISK_SECTOR_SIZE);
 			if (DO_DEVICE_DEBUG) {
 				DataPointer =
 						(INT32 *) DiskState[event_type - DISK_INTERRUPT ].Source;
@@ -2153,6 +2435,15 @@ void PrintHardwareStats(void) {
 		MeanNumberRunningProcesses, 
 		HardwareStats.NumberOfSystemCalls);
 	aprintf("CALLS = %5d\n  ", HardwareStats.NumberChargeTimes);
+	if (HardwareStats.TLBHits + HardwareStats.TLBMisses > 0)
+		aprintf("TLB: %d sets x %d ways, Hits = %d, Misses = %d, "
+				"Hit Rate = %5.3f, Invalidations = %d\n  ",
+				TLB_SETS, TLB_WAYS, HardwareStats.TLBHits,
+				HardwareStats.TLBMisses,
+				(double) HardwareStats.TLBHits
+						/ (double) (HardwareStats.TLBHits
+								+ HardwareStats.TLBMisses),
+				HardwareStats.TLBInvalidations);
 
 }               // End of PrintHardwareStats
 /*****************************************************************
@@ -2461,6 +2752,9 @@ void *Z502PrepareProcessForExecution() {
 		aprintf("Error 3 in Z502PrepareProcessForExecution\n");
 		HardwareInternalPanic(ERR_Z502_INTERNAL_BUG);
 	}
+	// The thread runs in the mode its context starts in (kernel mode), as
+	// SwitchContext and HardwareFault would have set it for a running one
+	ThreadTable[ourLocalID].Mode = ThreadTable[ourLocalID].Context->ProgramMode;
 	ReleaseLock(ThreadTableLock, "Z502PrepareProcessForExecution");
 	return (void *) ThreadTable[ourLocalID].Context->CodeEntry;
 }                                       // End of Z502PrepareProcessForExecution
@@ -3398,6 +3692,31 @@ void GoToExit(int Value) {
 	exit(Value);
 }             // End of GoToExit
 
+/*****************************************************************
+ GetMemorySize()
+
+ Read one of the memory sizes from the environment.  When the
+ variable isn't set the default is used; a value outside of
+ Smallest..Largest stops the simulation since nothing can be
+ built on it.
+ *****************************************************************/
+
+INT32 GetMemorySize(char *Name, INT32 Default, INT32 Smallest,
+		INT32 Largest) {
+	char *Text = getenv(Name);
+	INT32 Value;
+
+	if (Text == NULL)
+		return Default;
+	Value = atoi(Text);
+	if (Value < Smallest || Value > Largest) {
+		printf("%s = %s is not allowed, it must be from %d to %d\n", Name,
+				Text, Smallest, Largest);
+		exit(1);
+	}
+	return Value;
+}             // End of GetMemorySize
+
 /*****************************************************************
  Z502Init()
 
@@ -3408,6 +3727,7 @@ void GoToExit(int Value) {
 
 void Z502Init() {
 	INT16 i;
+	INT32 Byte;
 
 	if (Z502Initialized == FALSE) {
 		// Show that we've been in this code.
@@ -3416,6 +3736,24 @@ void Z502Init() {
 		// NOTE - this must NOT be an atomic printf
 		printf("This is Simulation Version %s and Hardware Version %s.\n\n",
 		           CURRENT_REL, HARDWARE_VERSION);
+
+		// The memory sizes must be known before anything is built on them
+		Z502PhysicalPages = GetMemorySize("Z502_PHYSICAL_PAGES",
+				DEFAULT_PHYSICAL_PAGES, 8, MAX_PHYSICAL_PAGES);
+		Z502VirtualPages = GetMemorySize("Z502_VIRTUAL_PAGES",
+				DEFAULT_VIRTUAL_PAGES, Z502PhysicalPages, MAX_VIRTUAL_PAGES);
+		Z502PageSize = GetMemorySize("Z502_PAGE_SIZE", DEFAULT_PGSIZE,
+				DISK_SECTOR_SIZE, MAX_PGSIZE);
+		if ((Z502PageSize & (Z502PageSize - 1)) != 0) {
+			printf("Z502_PAGE_SIZE must be a power of 2\n");
+			exit(1);
+		}
+		if (Z502PhysicalPages != DEFAULT_PHYSICAL_PAGES
+				|| Z502VirtualPages != DEFAULT_VIRTUAL_PAGES
+				|| Z502PageSize != DEFAULT_PGSIZE)
+			printf("Memory: %d frames, %d virtual pages, %d bytes per page\n\n",
+					Z502PhysicalPages, Z502VirtualPages, Z502PageSize);
+		MEMORY = (char *) malloc(Z502PhysicalPages * Z502PageSize);
 		GetProcessTimeUsage( &StartUserMicrosecs, 
 		                     &StartSystemMicrosecs,
 		                     &StartWallClockMicrosecs);
@@ -3455,8 +3793,8 @@ void Z502Init() {
 		for (i = 0; i < MEMORY_INTERLOCK_SIZE; i++)
 			InterlockRecord[i] = -1;
 
-		for (i = 0; i < sizeof(MEMORY); i++)
-			MEMORY[i] = i % 256;
+		for (Byte = 0; Byte < Z502PhysicalPages * Z502PageSize; Byte++)
+			MEMORY[Byte] = Byte % 256;
 
 		timer_state.timer_in_use = FALSE;
 		timer_state.event_ptr = NULL;
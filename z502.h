@@ -59,6 +59,13 @@
 
 #define         EVENT_RING_BUFFER_SIZE          16
 
+/*  Each processor has a TLB of TLB_SETS sets of TLB_WAYS entries.
+    TLB_WAYS 1 makes it direct mapped, TLB_SETS 1 fully associative.
+    TLB_SETS 0 turns it off.                                          */
+
+#define         TLB_SETS                        8
+#define         TLB_WAYS                        2
+
 /*  STAT_VECTOR is a two dimensional array.  The first
     dimension can take on values shown here.  The
     second dimension holds the error or device type.     */
@@ -101,20 +108,33 @@ typedef struct {
     INT32               NumberChargeTimes;
     INT32               NumberOfFaults;
     INT32               NumberOfSystemCalls;
+    INT32               TLBHits;
+    INT32               TLBMisses;
+    INT32               TLBInvalidations;
 } HARDWARE_STATS;
 
+typedef struct {
+    void                *Context;             // Context the translation belongs to
+    UINT16              *Entry;               // Page table entry it was loaded from
+    INT32               VirtualPage;
+    INT32               PhysicalPage;
+    INT32               LastUse;              // Used to choose the entry to replace
+    UINT16              Bits;                 // The entry when it was loaded
+    BOOL                Valid;
+} TLB_ENTRY;
+
 typedef struct {
     INT32               *queue;
     INT16               structure_id;
     INT16               disk_id;
     INT16               sector;
-    char                sector_data[PGSIZE];
+    char                sector_data[DISK_SECTOR_SIZE];
 } SECTOR;
 
 typedef struct {
     unsigned char       StructureID;          // A unique ID so we know it's a CONTEXT
     void                *CodeEntry;           // Location where program starts
-    UINT16              *PageTablePointer;    // Address of page table for this process
+    UINT16              **PageTablePointer;   // Address of page directory for this process
     INT32               ContextStartCount;     // How many times this context has been started
     INT16               ProgramMode;          // When last run, is it KEERNEL or USER
     BOOL                FaultInProgress;